@@ -103,21 +103,292 @@ static struct PT_struct PT_data;
 static struct PT_struct *const PT_dptr = &PT_data;
 
 
-static int16_t Prev_valBP, 
+static int16_t Count_SinceRR, RR1_p, RR2_p, 
+RR1_sum, RR2_sum, BlankTimeCnt, SBcntI;
+
+static pt_sample_t Prev_valBP, 
 Prev_Prev_valBP, Best_PeakBP, Prev_valDR, Prev_Prev_valDR, 
-Best_PeakDR, Old_PeakDR, Count_SinceRR, RR1_p, RR2_p, 
-RR1_sum, RR2_sum, BlankTimeCnt, SBcntI, SB_peakBP, SB_peakDR, 
+Best_PeakDR, Old_PeakDR, SB_peakBP, SB_peakDR, 
 y_h, st_mean_pkBP;
 
-static uint16_t MV_sum, PEAKI_temp, st_mx_pk, st_mean_pk,
+static pt_level_t MV_sum, PEAKI_temp, st_mx_pk, st_mean_pk,
 Prev_val, Prev_Prev_val, SB_peakI;
 
+static uint32_t Sample_Clock;									// Samples since PT_init, not cleared by the emergency reset
+
 
 #if (FILTER_FORM == 2)
-static int16_t LP_y_new, LP_y_old;
+static pt_sample_t LP_y_new, LP_y_old;
+#endif
+
+/********************************************************************************
+    Reciprocal table for heart-rate, HR_table[rr - HR_RR_MIN] = (60 * PT_FS / rr) in
+	Q(HR_Q). The table is generated by the preprocessor for the configured PT_FS.
+ ********************************************************************************/
+
+#define HR_NUM				(((uint32_t) 60 * PT_FS) << HR_Q)
+#define HR_E(rr)			((uint16_t) ((HR_NUM + ((rr) >> 1)) / (rr))),
+#define HR_E4(rr)			HR_E(rr) HR_E((rr) + 1) HR_E((rr) + 2) HR_E((rr) + 3)
+#define HR_E16(rr)			HR_E4(rr) HR_E4((rr) + 4) HR_E4((rr) + 8) HR_E4((rr) + 12)
+#define HR_E64(rr)			HR_E16(rr) HR_E16((rr) + 16) HR_E16((rr) + 32) HR_E16((rr) + 48)
+#define HR_E256(rr)			HR_E64(rr) HR_E64((rr) + 64) HR_E64((rr) + 128) HR_E64((rr) + 192)
+
+static const uint16_t HR_table[HR_TABLE_SIZE] = {
+	HR_E256(HR_RR_MIN) HR_E256(HR_RR_MIN + 256) HR_E256(HR_RR_MIN + 512)
+};
+
+
+#if (PT_LOW_LATENCY == 1)
+static int16_t Beat_Event, Prov_Pending, Prov_Delay;
+static int16_t Prov_Lost;										// Pending beat dropped with its peak, retracted by the next decision
+#endif
+
+#if (PT_HRV == 1)
+static struct PT_hrv_struct HRV_data;							// Sliding HRV window
+
+#define HRV_NN50			((int16_t) (PT_FS / 20))			// 50 msec in samples
+#endif
+
+#if (PT_LFHF == 1)
+static struct PT_lfhf_struct LFHF_data;							// Running spectrum
+static struct PT_lfhf_stats LFHF_last;							// Spectrum of the last complete block
+
+// ---- Goertzel coefficients 2*cos(2*pi*k/LFHF_N) in Q14 for k = 3 ... 25 ---- //
+static const int16_t LFHF_coef[LFHF_BINS] = {
+	32679, 32610, 32522, 32413, 32286, 32138, 31972,
+	31786, 31581, 31357, 31114, 30853, 30572, 30274, 29957, 29622, 29269, 28899, 28511, 28106, 27684, 27246, 26791
+};
+#endif
+
+#if (PT_HRSTAT == 1)
+static struct PT_hrstat_struct HRSTAT_data;
+
+// ---- Window lengths in samples, 1, 5 and 60 minutes ---- //
+static const uint32_t HRSTAT_win_len[HRSTAT_WINDOWS] = {
+	60 * (uint32_t) PT_FS, 300 * (uint32_t) PT_FS, 3600 * (uint32_t) PT_FS
+};
+#endif
+
+#if (PT_TREND == 1)
+static struct PT_trend_struct TREND_data;
+
+// ---- Bucket length in samples, ring size and ring offset in TREND_data.Buf of each level ---- //
+static const uint32_t TREND_len[TREND_LEVELS] = {
+	10 * (uint32_t) PT_FS, 60 * (uint32_t) PT_FS, 600 * (uint32_t) PT_FS, 3600 * (uint32_t) PT_FS
+};
+static const uint16_t TREND_size[TREND_LEVELS] = { 360, 120, 144, 96 };		// 1 h, 2 h, 24 h, 96 h
+static const uint16_t TREND_offset[TREND_LEVELS] = { 0, 360, 480, 624 };
+#endif
+
+#if (PT_ALARM == 1)
+static struct PT_alarm_struct ALARM_data;
+
+// ---- Asystole 4 sec, bradycardia below 50 bpm, tachycardia above 120 bpm, 8 irregular beats ---- //
+static struct PT_alarm_config ALARM_config = { PT4000MS, 50, 55, 120, 115, 8, 0 };
+#endif
+
+#if (PT_SQI == 1)
+static struct PT_sqi_struct SQI_data;
+#endif
+
+#if (PT_AGC == 1)
+static struct PT_agc_struct AGC_data;
+
+// ---- Inputs x[n - k] of the LP and HP filters, k = 0 - 11 and 0 - 31 ---- //
+#if (PT_FUSED_BP == 1)
+#define AGC_LP_X(k)			PT_dptr->BP_ring[(PT_dptr->BP_pointer - 1 - (k)) & (BP_RING_SIZE - 1)].X
+#define AGC_HP_X(k)			PT_dptr->BP_ring[(PT_dptr->BP_pointer - 1 - (k)) & (BP_RING_SIZE - 1)].V
+#else
+#define AGC_LP_X(k)			PT_dptr->LP_buf[(PT_dptr->LP_pointer + LP_BUFFER_SIZE - 1 - (k)) % LP_BUFFER_SIZE]
+#define AGC_HP_X(k)			PT_dptr->HP_buf[(PT_dptr->HP_pointer + HP_BUFFER_SIZE - 1 - (k)) % HP_BUFFER_SIZE]
+#endif
+#endif
+
+#if (PT_PREPROC == 1)
+static struct PT_pre_struct PRE_data;
+static int16_t PRE_mode = PRE_NONE, PRE_delay = 0;			// Kept over PT_init, see PT_set_Preprocess
+#define PRE_DELAY			PRE_delay
+#else
+#define PRE_DELAY			0
+#endif
+
+#if (PT_R_REFINE == 1)
+static struct PT_rpk_struct RPK_data;
+#endif
+
+#if (PT_TEMPLATE == 1)
+static struct PT_tpl_struct TPL_data;
+#endif
+
+#if (PT_EDR == 1)
+static struct PT_edr_struct EDR_data;
+#define EDR_BEAT(rr, amp)	EDRUpdate(rr, amp)
+#else
+#define EDR_BEAT(rr, amp)
+#endif
+
+#if (PT_MULTILEAD == 1)
+static struct PT_lead_bank ML_bank;
+static int16_t ML_weight[PT_LEADS], ML_weight_set = 0;		// Kept over PT_init, see PT_set_LeadWeight
+#endif
+
+#if (PT_QRS_WIDTH == 1)
+static struct PT_qrs_struct QRS_data;
+#define QRS_COPY(dst, src)	{ QRS_data.On[dst] = QRS_data.On[src]; QRS_data.Off[dst] = QRS_data.Off[src]; }
+#define QRS_EMIT(src)		QRSEmit(src)
+#else
+#define QRS_COPY(dst, src)
+#define QRS_EMIT(src)
+#endif
+
+#if (PT_GAP == 1)
+static int16_t GAP_prime, GAP_warm;							// Prime the filters on the next sample, samples left without decisions
+#endif
+
+#if (PT_SNAPSHOT == 1)
+#define SNAP_CONFIG			((uint32_t) PT_FS << 20 | (uint32_t) sizeof(pt_sample_t) << 17 |			\
+							PT_FUSED_BP | PT_LOW_LATENCY << 1 | PT_HRV << 2 | PT_LFHF << 3 |			\
+							PT_HRSTAT << 4 | PT_TREND << 5 | PT_ALARM << 6 | PT_SQI << 7 |				\
+							PT_CLIP_STATS << 8 | PT_AGC << 9 | PT_PREPROC << 10 | PT_R_REFINE << 11 |	\
+							PT_QRS_WIDTH << 12 | PT_TEMPLATE << 13 | PT_MULTILEAD << 14 |				\
+							PT_EDR << 15 | PT_GAP << 16)
+#define SNAP(v)				do { if (buf) { if (save) memcpy(buf + size, &(v), sizeof(v));				\
+							else memcpy(&(v), buf + size, sizeof(v)); } size += sizeof(v); } while (0)
+#endif
+
+/**************************************************
+Filter stages of PT_StateMachine. The built-in filters are
+called directly unless a user stage is given at compile
+time (PT_STAGE_BANDPASS...) or, with PT_STAGE_OPS, at run
+time. User stages get and return values, the built-in
+ones work on PT_dptr in place.
+***************************************************/
+#if (PT_STAGE_OPS == 1)
+static struct PT_stage_ops STAGE_ops;						// Kept over PT_init, see PT_set_StageOps
+#define STAGE_DELAY			(PT_STAGE_DELAY + STAGE_ops.Delay)
+#define STAGE_CALL(f, in, out, builtin)	do { if (STAGE_ops.f) out = STAGE_ops.f(in); else builtin; } while (0)
+#else
+#define STAGE_DELAY			PT_STAGE_DELAY
+#define STAGE_CALL(f, in, out, builtin)	do { builtin; } while (0)
+#endif
+
+#ifdef PT_STAGE_BANDPASS
+#define STAGE_BANDPASS(x)	(PT_dptr->LPF_val = PT_dptr->HPF_val = PT_STAGE_BANDPASS(x))
+#elif (PT_FUSED_BP == 1)
+#define STAGE_BANDPASS(x)	STAGE_CALL(Bandpass, x, PT_dptr->LPF_val = PT_dptr->HPF_val, BPFilter(&(x)))
+#else
+#define STAGE_BANDPASS(x)	STAGE_CALL(Bandpass, x, PT_dptr->LPF_val = PT_dptr->HPF_val, (LPFilter(&(x)), HPFilter()))
+#endif
+#ifdef PT_STAGE_DERIV
+#define STAGE_DERIV()		(PT_dptr->DRF_val = PT_STAGE_DERIV(PT_dptr->HPF_val))
+#else
+#define STAGE_DERIV()		STAGE_CALL(Deriv, PT_dptr->HPF_val, PT_dptr->DRF_val, DerivFilter())
+#endif
+#ifdef PT_STAGE_SQUARE
+#define STAGE_SQUARE()		(PT_dptr->SQF_val = PT_STAGE_SQUARE(PT_dptr->DRF_val))
+#else
+#define STAGE_SQUARE()		STAGE_CALL(Square, PT_dptr->DRF_val, PT_dptr->SQF_val, SQRFilter())
+#endif
+#ifdef PT_STAGE_INTEGRATE
+#define STAGE_INTEGRATE()	(PT_dptr->MVA_val = PT_STAGE_INTEGRATE(PT_dptr->SQF_val))
+#else
+#define STAGE_INTEGRATE()	STAGE_CALL(Integrate, PT_dptr->SQF_val, PT_dptr->MVA_val, MVAFilter())
+#endif
+
+#define PT_DELAY			((int16_t) (GENERAL_DELAY + PRE_DELAY + STAGE_DELAY))	// Delay of the whole pipeline
+#define OFFLINE_SHIFT		(PT_DELAY - GENERAL_DELAY + BP_DELAY)					// Part of PT_DELAY without delay offline
+
+#if (PT_CLIP_STATS == 1)
+static struct PT_clip_stats CLIP_data;
+#define CLIP_COUNT(cond, cnt)	do { if (cond) ++CLIP_data.cnt; } while (0)
+#else
+#define CLIP_COUNT(cond, cnt)	do { } while (0)
 #endif
 
 
+/**********************************************************************************
+	Filter steps of one lead, the state is passed in. Shared by the stages of
+	PT_StateMachine (LPFilter, HPFilter, BPFilter, DerivFilter, SQRFilter) and
+	the lead loop of PT_StateMachineLeads, so both clamp and count alike.
+**********************************************************************************/
+
+// ------ LP gain down, w / 32 with the sign kept ------ //
+static inline pt_sample_t LPGain(pt_sample_t w)
+{
+	pt_sample_t v;
+
+	if (w >= 0)
+		return (w >> 5);
+	v = (w >> 5) | LP_SIGN_FILL;
+	CLIP_COUNT(v != (w >> 5), LP_Sign);
+	return (v);
+}
+
+// ------ HP gain down, y / 2 with the sign kept ------ //
+static inline pt_sample_t HPGain(pt_sample_t y)
+{
+	pt_sample_t v;
+
+	if (y >= 0)
+		return (y >> 1);
+	v = (y >> 1) | HP_SIGN_FILL;
+	CLIP_COUNT(v != (y >> 1), HP_Sign);
+	return (v);
+}
+
+// ------ LowPass (Form II), w[n] = 2w[n - 1] - w[n - 2] + x[n] - 2x[n - 6] + x[n - 12] ------ //
+static inline pt_sample_t LPStep(pt_sample_t *y_old, pt_sample_t *y_new, pt_sample_t x, pt_sample_t x6, pt_sample_t x12)
+{
+	pt_sample_t w = (*y_old << 1) - *y_new + x - (x6 << 1) + x12;
+
+	*y_new = *y_old;
+	*y_old = w;
+	return (LPGain(w));
+}
+
+// ------ HighPass (Form II), y[n] = y[n - 1] + v[n - 32]/32 - v[n]/32 + v[n - 16] - v[n - 17] ------ //
+static inline pt_sample_t HPStep(pt_sample_t *y, pt_sample_t v, pt_sample_t v16, pt_sample_t v17, pt_sample_t v32)
+{
+	*y += (v32 >> 5) - (v >> 5) + v16 - v17;
+	return (HPGain(*y));
+}
+
+// ------ Derivative, buf holds x[n - 1] .. x[n - 4] every stride entries ------ //
+static inline pt_sample_t DerivStep(pt_sample_t *buf, int16_t stride, pt_sample_t x)
+{
+	pt_sample_t w;
+
+	w = buf[0] - buf[2 * stride];
+	w += ((x - buf[3 * stride]) << 1);
+	w >>= 3;
+	buf[3 * stride] = buf[2 * stride];
+	buf[2 * stride] = buf[stride];
+	buf[stride] = buf[0];
+	buf[0] = x;
+	return (w);
+}
+
+// ------ Squaring, hardlimited to SQR_LIM_OUT ------ //
+static inline pt_level_t SQRStep(pt_sample_t x)
+{
+	pt_level_t a, sq;
+
+	if (x > SQR_LIM_VAL || x < (-SQR_LIM_VAL)) {
+		sq = PT_LEVEL_MAX;
+		CLIP_COUNT(1, SQR_In);
+	}
+	else {
+		a = (pt_level_t) ((x < 0) ? -x : x);
+		sq = a * a;
+		CLIP_COUNT(sq > SQR_LIM_OUT, SQR_Out);
+	}
+
+	if (sq > SQR_LIM_OUT)
+		sq = SQR_LIM_OUT;
+	return (sq);
+}
+
+
 /**********************************************************************************
 
     Fuction Name: PT_init
@@ -128,12 +399,114 @@ static int16_t LP_y_new, LP_y_old;
 
      Returns: none
 
-    Description: initializes the PanTompkins (PT) data structure and RR interval,
-	and filter Buffers.
+    Description: initializes the detector (see ResetDetector) and the optional
+	modules that follow the beats over long periods (e.g. HRV).
 
  *******************************************************************************/
 
 void PT_init( void )
+{
+#if (PT_TREND == 1 || PT_MULTILEAD == 1)
+	int16_t idex;
+#endif
+
+	ResetDetector();
+	Sample_Clock = 0;
+
+#if (PT_HRV == 1)
+	memset(&HRV_data, 0, sizeof(HRV_data));
+#endif
+
+#if (PT_LFHF == 1)
+	memset(&LFHF_data, 0, sizeof(LFHF_data));
+	memset(&LFHF_last, 0, sizeof(LFHF_last));
+#endif
+
+#if (PT_HRSTAT == 1)
+	memset(&HRSTAT_data, 0, sizeof(HRSTAT_data));
+#endif
+
+#if (PT_TREND == 1)
+	memset(&TREND_data, 0, sizeof(TREND_data));
+	for (idex = 0; idex < TREND_LEVELS; idex++)
+		TREND_data.Cur[idex].Min = UINT16_MAX;
+#endif
+
+#if (PT_ALARM == 1)
+	memset(&ALARM_data, 0, sizeof(ALARM_data));
+#endif
+
+#if (PT_CLIP_STATS == 1)
+	memset(&CLIP_data, 0, sizeof(CLIP_data));
+#endif
+
+#if (PT_AGC == 1)
+	memset(&AGC_data, 0, sizeof(AGC_data));
+#endif
+
+#if (PT_PREPROC == 1)
+	memset(&PRE_data, 0, sizeof(PRE_data));
+#endif
+
+#if (PT_R_REFINE == 1)
+	memset(&RPK_data, 0, sizeof(RPK_data));
+#endif
+
+#if (PT_TEMPLATE == 1)
+	memset(&TPL_data, 0, sizeof(TPL_data));
+	TPL_data.Cluster = -1;
+#endif
+
+#if (PT_QRS_WIDTH == 1)
+	memset(&QRS_data, 0, sizeof(QRS_data));
+#endif
+
+#if (PT_EDR == 1)
+	memset(&EDR_data, 0, sizeof(EDR_data));
+#endif
+
+#if (PT_GAP == 1)
+	GAP_prime = GAP_warm = 0;
+#endif
+
+#if (PT_MULTILEAD == 1)
+	memset(&ML_bank, 0, sizeof(ML_bank));
+	for (idex = 0; idex < PT_LEADS; idex++) {
+		if (!ML_weight_set)
+			ML_weight[idex] = ML_WEIGHT_ONE;
+		ML_bank.Usable[idex] = 1;
+		ML_bank.Min[idex] = SQI_RAIL_HIGH;
+		ML_bank.Max[idex] = SQI_RAIL_LOW;
+	}
+	LeadWeights();
+#endif
+
+#if (PT_SQI == 1)
+	memset(&SQI_data, 0, sizeof(SQI_data));
+	SQI_data.Min = SQI_RAIL_HIGH;
+	SQI_data.Max = SQI_RAIL_LOW;
+	SQI_data.Good_Blocks = SQI_GOOD_BLOCKS;
+#endif
+}
+
+
+/**********************************************************************************
+
+    Fuction Name: ResetDetector
+
+
+    Parameter:
+     Input:   none
+
+     Returns: none
+
+    Description: initializes the PanTompkins (PT) data structure and RR interval,
+	and filter Buffers. Also called by the emergency reset of PT_StateMachine, which
+	therefore leaves the optional long-term modules untouched.
+
+ *******************************************************************************/
+
+void ResetDetector( void )
 {
 	/**************************************************
 	Initialize Pan_Tompkins structure.
@@ -149,8 +522,12 @@ void PT_init( void )
 	PT_dptr->RR_High_L		= RR116PERCENT;
 	PT_dptr->RR_Missed_L	= RR166PERCENT;
 
+#if (PT_FUSED_BP == 1)
+	PT_dptr->BP_pointer		= 0;
+#else
 	PT_dptr->LP_pointer		= 0;
 	PT_dptr->HP_pointer		= 0;
+#endif
 	PT_dptr->MVA_pointer	= 0;
 
 	PT_dptr->HR_State = REGULAR_HR;
@@ -161,10 +538,16 @@ void PT_init( void )
 	**************************************************/
 	int8_t idex;
 
+#if (PT_FUSED_BP == 1)
+	for (idex = 0; idex < BP_RING_SIZE; idex++)
+		PT_dptr->BP_ring[idex].X	=
+			PT_dptr->BP_ring[idex].V = 0;							//  Fused LP and HP filter buffer
+#else
 	for (idex = 0; idex < LP_BUFFER_SIZE; idex++)
 		PT_dptr->LP_buf[idex]		= 0;							//  LP filter buffer
 	for (idex = 0; idex < HP_BUFFER_SIZE; idex++)
 		PT_dptr->HP_buf[idex]		= 0;							//  HP filter buffer
+#endif
 	for (idex = 0; idex < DR_BUFFER_SIZE; idex++)
 		PT_dptr->DR_buf[idex]		= 0;							//  DR filter buffer
 	for (idex = 0; idex < MVA_BUFFER_SIZE; idex++)
@@ -194,6 +577,21 @@ void PT_init( void )
 #if (FILTER_FORM == 2)
 	LP_y_new = LP_y_old = 0;										// Parameters for DirectForm || LP filter
 #endif
+
+#if (PT_LOW_LATENCY == 1)
+	Beat_Event = BEAT_NONE;											// Provisional beat event of the current sample
+	Prov_Pending = 0;												// A provisional beat waits for the blanking time
+	Prov_Delay = 0;													// Delay of the provisional peak to the current sample
+	Prov_Lost = 0;													// A pending provisional beat has been dropped
+#endif
+
+#ifdef PT_STAGE_RESET
+	PT_STAGE_RESET();												// User filter stages
+#endif
+#if (PT_STAGE_OPS == 1)
+	if (STAGE_ops.Reset)
+		STAGE_ops.Reset();
+#endif
 }
 
 /**********************************************************************************
@@ -216,26 +614,109 @@ void PT_init( void )
 
  **********************************************************************************/
 
-int16_t PT_StateMachine(int16_t datum)
+int16_t PT_StateMachine(pt_sample_t datum)
 {
-	int16_t BeatDelay = 0;
+	pt_level_t PEAKI ;
+#if (PT_R_REFINE == 1)
+	int16_t BeatDelay;
+#endif
+
+	++Sample_Clock;
+
+#if (PT_R_REFINE == 1)
+	RPK_data.Ring[RPK_data.Idx++ & (RPK_RING_SIZE - 1)] = datum;	// Input history for the R apex
+#endif
+
+#if (PT_SQI == 1)
+	SQIUpdate(datum);										// Signal quality of the lead
+#endif
 
-	uint16_t PEAKI ;
+#if (PT_PREPROC == 1)
+	if (PRE_mode)
+		Preprocess(&datum);									// Powerline and baseline wander removal
+#endif
+
+#if (PT_AGC == 1)
+	AGCUpdate(&datum);										// Automatic gain control
+#endif
+
+#if (PT_GAP == 1)
+	if (GAP_prime)
+		GapPrime(datum);									// First sample after a gap
+#endif
 
 	// ------- Preprocessing filtering and Peak detection --------- //
-	LPFilter(&datum);										// LowPass filtering
-	HPFilter();												// HighPass filtering
+	STAGE_BANDPASS(datum);									// LowPass and HighPass filtering
 
 	PeakDtcBP(PT_dptr->HPF_val);							// Store BP signal highest peak
 	
-	DerivFilter();
+	STAGE_DERIV();
 	PeakDtcDR(PT_dptr->DRF_val);							// Store the highest slope for T wave discrimination
 
-	SQRFilter();											//Squaring
+	STAGE_SQUARE();											//Squaring
 
-	MVAFilter();
+	STAGE_INTEGRATE();
 	PEAKI = PeakDtcI();
 
+#if (PT_GAP == 1)
+	// ---- Filters settling after a gap, the decision logic only counts the samples ---- //
+	if (GAP_warm) {
+		--GAP_warm;
+		PEAKI = 0;
+	}
+#endif
+
+#if (PT_SQI == 1)
+	// ---- Unusable lead, only keep the filters running ---- //
+	if (SQI_data.Status != LEAD_OK) {
+#if (PT_LOW_LATENCY == 1)
+		// ---- A beat pending when the lead was lost is retracted on this sample ---- //
+		Beat_Event = Prov_Lost ? BEAT_RETRACTED : BEAT_NONE;
+		Prov_Delay += Prov_Lost;
+		Prov_Lost = 0;
+#endif
+		return (0);
+	}
+#endif
+
+#if (PT_R_REFINE == 1)
+	if ((BeatDelay = BeatDecision(PEAKI)) != 0) {
+		RPeakRefine(BeatDelay);
+#if (PT_TEMPLATE == 1)
+		TemplateUpdate();									// Morphology of the beat
+#endif
+	}
+	return (BeatDelay);
+#else
+	return (BeatDecision(PEAKI));
+#endif
+}
+
+
+/**********************************************************************************
+
+	Fuction Name: BeatDecision
+
+	Parameter:
+	 Input	:	PEAKI		- Peak of the integrated signal found by PeakDtcI, 0 if none.
+
+	 Returns:	BeatDelay	- If non-zero a qrs has been detected with BeatDelay samples.
+
+	Description: Decision part of PT_StateMachine, called once per sample after the
+	filters. Holds the peaks for the blanking time, runs the learning phases, compares
+	the peaks to the adaptive thresholds, does the T-wave test and the search-back and
+	finally the emergency reset. Shared by PT_StateMachine and PT_Offline.
+
+ **********************************************************************************/
+
+int16_t BeatDecision(pt_level_t PEAKI)
+{
+	int16_t BeatDelay = 0;
+
+#if (PT_QRS_WIDTH == 1)
+	QRSEdge(PEAKI);											// Rising edge of the integrated signal
+#endif
+
 	// ---- Integrated Peak detection checks and blankTime ---- //
 	if (!PEAKI && BlankTimeCnt)								// No beat, decrement BlankTime
 	{
@@ -246,6 +727,7 @@ int16_t PT_StateMachine(int16_t datum)
 	{
 		BlankTimeCnt = PT200MS;
 		PEAKI_temp   = PEAKI;
+		QRS_COPY(QRS_HELD, QRS_PEAK);
 		PEAKI = 0;
 	}
 	else if(PEAKI)											// If a bigger peak comes along, store it
@@ -254,6 +736,7 @@ int16_t PT_StateMachine(int16_t datum)
 		{
 			BlankTimeCnt = PT200MS;
 			PEAKI_temp = PEAKI;
+			QRS_COPY(QRS_HELD, QRS_PEAK);
 			PEAKI = 0;
 		}
 		else if (--BlankTimeCnt == 0)
@@ -262,6 +745,25 @@ int16_t PT_StateMachine(int16_t datum)
 			PEAKI = 0;
 	}
 
+#if (PT_LOW_LATENCY == 1)
+	// ---- Report a provisional beat once the stored peak passes ThI1 and ThF1 ---- //
+	Beat_Event = BEAT_NONE;
+	if (Prov_Lost) {										// Dropped by a gap, see DecisionRestart
+		Beat_Event = BEAT_RETRACTED;
+		++Prov_Delay;
+		Prov_Lost = 0;
+	}
+	else if (Prov_Pending)									// Back to PT_DELAY when a bigger peak replaces the held one
+		Prov_Delay = (BlankTimeCnt == PT200MS) ? PT_DELAY : Prov_Delay + 1;
+	else if (BlankTimeCnt == PT200MS && PT_dptr->PT_state == DETECTING &&
+		PEAKI_temp > PT_dptr->ThI1 && Best_PeakBP > PT_dptr->ThF1)
+	{
+		Beat_Event = BEAT_PROVISIONAL;
+		Prov_Pending = 1;
+		Prov_Delay = PT_DELAY;
+	}
+#endif
+
 	// -- Run Different Phases of the Algo -> Learning Ph1, 2 and decision --//
 	++Count_SinceRR;
 	if (PT_dptr->PT_state == START_UP || PT_dptr->PT_state == LEARN_PH_1)		
@@ -284,7 +786,9 @@ int16_t PT_StateMachine(int16_t datum)
 				UpdateThF(&Best_PeakBP, 0);
 
 				// --- First RR interval --- //
-				BeatDelay = GENERAL_DELAY + PT200MS;
+				BeatDelay = PT_DELAY + PT200MS;
+				QRS_EMIT(QRS_HELD);
+				EDR_BEAT(0, Best_PeakBP);
 				Count_SinceRR = 0;
 				Old_PeakDR = Best_PeakDR;
 				Best_PeakDR = 0;
@@ -313,7 +817,9 @@ int16_t PT_StateMachine(int16_t datum)
 					UpdateRR(Count_SinceRR);
 
 					// --- Reset parameters --- //
-					BeatDelay = GENERAL_DELAY + PT200MS;
+					BeatDelay = PT_DELAY + PT200MS;
+					QRS_EMIT(QRS_HELD);
+					EDR_BEAT(Count_SinceRR, Best_PeakBP);
 					Count_SinceRR = 0;
 					Old_PeakDR = Best_PeakDR;									// Store the derivative for T-wave test
 					Best_PeakDR = Best_PeakBP = 0;
@@ -340,6 +846,7 @@ int16_t PT_StateMachine(int16_t datum)
 				SB_peakBP = Best_PeakBP;									// Store BP Sig peak
 				SB_peakDR = Best_PeakDR;									// Derivative of SB point
 				SBcntI = Count_SinceRR;										// Store Indice
+				QRS_COPY(QRS_SB, QRS_HELD);
 			}
 
 		}
@@ -356,10 +863,12 @@ int16_t PT_StateMachine(int16_t datum)
 			UpdateThI(&SB_peakI, 0);
 			UpdateThF(&SB_peakBP, 0);
 			UpdateRR(SBcntI);
+			EDR_BEAT(SBcntI, SB_peakBP);
 
 			// --- Reset parameters --- //
 			BeatDelay = Count_SinceRR = Count_SinceRR - SBcntI;
-			BeatDelay += (GENERAL_DELAY + PT200MS);
+			BeatDelay += (PT_DELAY + PT200MS);
+			QRS_EMIT(QRS_SB);
 			Old_PeakDR = SB_peakDR;		// Store the derivative for T-wave test
 			Best_PeakDR = Best_PeakBP = 0;
 
@@ -370,11 +879,24 @@ int16_t PT_StateMachine(int16_t datum)
 		}
 	}
 
+#if (PT_LOW_LATENCY == 1)
+	// ---- Blanking time over, confirm or retract the provisional beat ---- //
+	if (Prov_Pending && !BlankTimeCnt)
+	{
+		Beat_Event = (BeatDelay && !Count_SinceRR) ? BEAT_CONFIRMED : BEAT_RETRACTED;
+		Prov_Pending = 0;
+	}
+#endif
+
+#if (PT_ALARM == 1)
+	AlarmUpdate(BeatDelay);
+#endif
+
 	// ---- Emergency and Faulty Condition Reset ---- //
 	// If algorithm doest not find a beat in 4sec, then it resets itself
 	// and starts learning phases.
 	if (Count_SinceRR > PT4000MS) {
-		PT_init();
+		ResetDetector();
 	}
 
 	return (BeatDelay);
@@ -397,7 +919,7 @@ int16_t PT_StateMachine(int16_t datum)
 
  **********************************************************************************/
 
-void LearningPhase1(uint16_t *pkI, int16_t *pkBP)
+void LearningPhase1(pt_level_t *pkI, pt_sample_t *pkBP)
 {
 	//---- Recursively compute the average and max of peaks ------ //
 	if (*pkI > st_mx_pk) st_mx_pk = *pkI;
@@ -418,7 +940,7 @@ void LearningPhase1(uint16_t *pkI, int16_t *pkBP)
 		// ---- Integrated Signal Thresholds ------- //
 		PT_dptr->SPKI = (st_mx_pk >> 1);
 		PT_dptr->NPKI = (st_mean_pk >> 3);
-		PT_dptr->ThI1 = PT_dptr->NPKI + ((PT_dptr->SPKI - PT_dptr->NPKI) >> 2);
+		PT_dptr->ThI1 = PT_dptr->NPKI + ((pt_acc_t) (PT_dptr->SPKI - PT_dptr->NPKI) >> 2);
 		PT_dptr->ThI2 = PT_dptr->ThI1 >> 1;
 
 		// -------- BP Signal Thresholds ---------- //
@@ -430,6 +952,39 @@ void LearningPhase1(uint16_t *pkI, int16_t *pkBP)
 	}
 }
 
+#if (PT_FUSED_BP == 1)
+/**********************************************************************************
+
+Fuction Name: BPFilter
+
+Parameter:
+Input	:	val		- Pointer to the input sample.
+
+Returns:	none	- Updates PT_dptr->LPF_val and PT_dptr->HPF_val in place.
+
+Description: LPFilter and HPFilter (FILTER_FORM 2) fused in one function. Both are
+running-sum FIRs, the LP needs x[n - 6] and x[n - 12] and the HP v[n - 16], v[n - 17]
+and v[n - 32] of the LP output v. One ring of BP_RING_SIZE taps holds x and v of each
+sample, so a single power-of-two index replaces the two pointers and half-pointers.
+The outputs are identical to LPFilter followed by HPFilter. Delay 21 samples.
+
+**********************************************************************************/
+void BPFilter(pt_sample_t *val)
+{
+	struct PT_bp_tap *ring = PT_dptr->BP_ring;
+	int16_t i = PT_dptr->BP_pointer;								// Holds x[n - 32] and v[n - 32]
+	pt_sample_t v;
+
+	// ------- LowPass, then HighPass on its output ------- //
+	v = LPStep(&LP_y_old, &LP_y_new, *val, ring[(i - 6) & (BP_RING_SIZE - 1)].X, ring[(i - 12) & (BP_RING_SIZE - 1)].X);
+	PT_dptr->HPF_val = HPStep(&y_h, v, ring[(i - 16) & (BP_RING_SIZE - 1)].V, ring[(i - 17) & (BP_RING_SIZE - 1)].V, ring[i].V);
+	PT_dptr->LPF_val = v;
+
+	ring[i].X = *val;
+	ring[i].V = v;
+	PT_dptr->BP_pointer = (i + 1) & (BP_RING_SIZE - 1);
+}
+#else
 /**********************************************************************************
 
     Fuction Name: LPFilter
@@ -446,10 +1001,13 @@ void LearningPhase1(uint16_t *pkI, int16_t *pkBP)
 
  **********************************************************************************/
 
-void LPFilter(int16_t *val)
+void LPFilter(pt_sample_t *val)
 {
 	// -- To avoid using modulo employ half-pointer -- //
-	int16_t half_pointer, w;
+	int16_t half_pointer;
+#if (FILTER_FORM == 1)
+	pt_sample_t w;
+#endif
 
 	half_pointer = PT_dptr->LP_pointer - (LP_BUFFER_SIZE >> 1);
 
@@ -463,17 +1021,13 @@ void LPFilter(int16_t *val)
 		w = *val + (PT_dptr->LP_buf[1] << 1) - PT_dptr->LP_buf[0];
 		*val = w - (PT_dptr->LP_buf[half_pointer] << 1) + PT_dptr->LP_buf[PT_dptr->LP_pointer];
 		PT_dptr->LP_buf[PT_dptr->LP_pointer] = w;
+
+		// --- Avoid signal overflow by gaining down ---- //
+		PT_dptr->LPF_val = LPGain(w);
 #else
-		w = (LP_y_old << 1) - LP_y_new + *val - (PT_dptr->LP_buf[half_pointer] << 1) + PT_dptr->LP_buf[PT_dptr->LP_pointer];
-		LP_y_new = LP_y_old;
-		LP_y_old = w;
+		PT_dptr->LPF_val = LPStep(&LP_y_old, &LP_y_new, *val, PT_dptr->LP_buf[half_pointer], PT_dptr->LP_buf[PT_dptr->LP_pointer]);
 		PT_dptr->LP_buf[PT_dptr->LP_pointer] = *val;
 #endif
-		// --- Avoid signal overflow by gaining down ---- //
-		if (w >= 0)
-			PT_dptr->LPF_val = w >> 5;
-		else
-			PT_dptr->LPF_val = (w >> 5) | 0xF800;
 
 		if (++PT_dptr->LP_pointer == LP_BUFFER_SIZE) 
 			PT_dptr->LP_pointer = 0;
@@ -516,19 +1070,17 @@ void HPFilter(void)
 	y_h = PT_dptr->LPF_val + PT_dptr->HP_buf[0];
 	PT_dptr->LPF_val = ((PT_dptr->HP_buf[PT_dptr->HP_pointer] - y_h) >> 5) + PT_dptr->HP_buf[half_pointer] - PT_dptr->HP_buf[h_prev_pointer];
 	PT_dptr->HP_buf[PT_dptr->HP_pointer] = y_h;
+
+	// ------- Again slightly gaining down --------- //
+	PT_dptr->HPF_val = HPGain(y_h);
 #else
-	y_h += (PT_dptr->HP_buf[PT_dptr->HP_pointer] >> 5) - (PT_dptr->LPF_val >> 5) + PT_dptr->HP_buf[half_pointer] - PT_dptr->HP_buf[h_prev_pointer];
+	PT_dptr->HPF_val = HPStep(&y_h, PT_dptr->LPF_val, PT_dptr->HP_buf[half_pointer], PT_dptr->HP_buf[h_prev_pointer], PT_dptr->HP_buf[PT_dptr->HP_pointer]);
 	PT_dptr->HP_buf[PT_dptr->HP_pointer] = PT_dptr->LPF_val;
-	
 #endif
-	// ------- Again slightly gaining down --------- //
-	if (y_h >= 0)
-		PT_dptr->HPF_val = (y_h >> 1);
-	else
-		PT_dptr->HPF_val = (y_h >> 1) | 0xF800;
 
 	if (++PT_dptr->HP_pointer == HP_BUFFER_SIZE) PT_dptr->HP_pointer = 0;
 }
+#endif
 
 /**********************************************************************************
 
@@ -547,16 +1099,7 @@ y[n] = 1/8(2x[n] + x[n - 1] - x[n - 3] - 2x[n - 4]) . Delay 2 samples.
 void DerivFilter(void)
 {
 	// --- Since it is only a 5 point derivative filter we avoid using pointers and half pointers for further efficieny ---- //
-	int16_t w;
-
-	w = PT_dptr->DR_buf[0] - PT_dptr->DR_buf[2];
-	w += ((PT_dptr->HPF_val - PT_dptr->DR_buf[3]) << 1);
-	w >>= 3;
-	PT_dptr->DR_buf[3] = PT_dptr->DR_buf[2];
-	PT_dptr->DR_buf[2] = PT_dptr->DR_buf[1];
-	PT_dptr->DR_buf[1] = PT_dptr->DR_buf[0];
-	PT_dptr->DR_buf[0] = PT_dptr->HPF_val;
-	PT_dptr->DRF_val = w;
+	PT_dptr->DRF_val = DerivStep(PT_dptr->DR_buf, 1, PT_dptr->HPF_val);
 }
 
 /**********************************************************************************
@@ -575,20 +1118,7 @@ y[n] = x[n]^2. No delay.
 void SQRFilter(void)
 {
 	// ------------ Avoiding Overflow -------------- //
-	uint16_t temp;
-	if (PT_dptr->DRF_val > SQR_LIM_VAL || PT_dptr->DRF_val < (-SQR_LIM_VAL))
-		PT_dptr->SQF_val = UINT16_MAX;
-	else
-	{
-		if (PT_dptr->DRF_val < 0)
-			temp = (uint16_t)(-PT_dptr->DRF_val);
-		else
-			temp = (uint16_t)(PT_dptr->DRF_val);
-		PT_dptr->SQF_val = temp*temp;
-	}
-
-	if (PT_dptr->SQF_val > SQR_LIM_OUT)
-		PT_dptr->SQF_val = SQR_LIM_OUT;
+	PT_dptr->SQF_val = SQRStep(PT_dptr->DRF_val);
 }
 
 
@@ -607,11 +1137,13 @@ based on Eq. 11 of Pan-Tompkins, y[n] = (1/N)[sum(x[1]+...+x[N])]. Delay 15 Samp
 **********************************************************************************/
 void MVAFilter(void)
 {
-	//---- The MV_sum can easily overflow so we limit the bound by uint16 precision ------ //
-	if (MV_sum < (UINT16_MAX - PT_dptr->SQF_val))
+	//---- The MV_sum can easily overflow so we limit the bound by its precision ------ //
+	if (MV_sum < (PT_LEVEL_MAX - PT_dptr->SQF_val))
 		MV_sum += PT_dptr->SQF_val;
-	else
-		MV_sum = UINT16_MAX;
+	else {
+		MV_sum = PT_LEVEL_MAX;
+		CLIP_COUNT(1, MVA_Sum);
+	}
 
 	if (MV_sum > PT_dptr->MVA_buf[PT_dptr->MVA_pointer])
 		MV_sum -= PT_dptr->MVA_buf[PT_dptr->MVA_pointer];
@@ -622,8 +1154,10 @@ void MVAFilter(void)
 
 	PT_dptr->MVA_val = MV_sum/(uint16_t) MVA_BUFFER_SIZE;
 
-	if (PT_dptr->MVA_val > MVA_LIM_VAL)
+	if (PT_dptr->MVA_val > MVA_LIM_VAL) {
 		PT_dptr->MVA_val = MVA_LIM_VAL;
+		CLIP_COUNT(1, MVA_Lim);
+	}
 
 	if (++PT_dptr->MVA_pointer == MVA_BUFFER_SIZE) 
 		PT_dptr->MVA_pointer = 0;
@@ -644,9 +1178,9 @@ If the signal changes sign the value of the peak is asssumed ot be a peak.
 if x[n-1] <= x[n] > x[n+1], then x[n] is a peak.
 
 **********************************************************************************/
-uint16_t PeakDtcI(void)
+pt_level_t PeakDtcI(void)
 {
-	uint16_t p;
+	pt_level_t p;
 	// ---------- Local maxima or not --------- //
 	if (PT_dptr->MVA_val <= Prev_val && Prev_val > Prev_Prev_val) {
 		p = Prev_val;
@@ -676,7 +1210,7 @@ For T-wave discrimination see T-wave identification of the paper.
 if x[n-1] <= x[n] > x[n+1], then x[n] is a peak.
 
 **********************************************************************************/
-void PeakDtcDR(int16_t DR_sample)
+void PeakDtcDR(pt_sample_t DR_sample)
 {
 	if (DR_sample < 0) DR_sample = -DR_sample;
 	// ---------- Local maxima or not --------- //
@@ -703,7 +1237,7 @@ against adaptive thresholds.
 if x[n-1] <= x[n] > x[n+1], then x[n] is a peak.
 
 **********************************************************************************/
-void PeakDtcBP(int16_t DR_sample)
+void PeakDtcBP(pt_sample_t DR_sample)
 {
 	if (DR_sample < 0) DR_sample = -DR_sample;
 	// ---------- Local maxima or not --------- //
@@ -773,76 +1307,2006 @@ void UpdateRR(int16_t qrs)
 		PT_dptr->ThF1 >>= 1;
 		PT_dptr->HR_State = IRREGULAR_HR;
 	}
-	
-}
 
+#if (PT_HRV == 1)
+	HRVUpdate(qrs);
+#endif
+#if (PT_LFHF == 1)
+	LFHFUpdate(qrs);
+#endif
+#if (PT_HRSTAT == 1)
+	HRStatUpdate(qrs);
+#endif
+#if (PT_TREND == 1)
+	TrendUpdate(qrs);
+#endif
+}
+
+
+/**********************************************************************************
+
+Fuction Name: UpdateThI
+
+Parameter:
+Input	:	PEAKI	- Pointer to the overal peak
+			NOISE_F	- flag that indicates whether the peak is noise or not.
+
+Returns	:	none	- Recieves PEAKI and updates Signal peak estimate (SPKI), Noise peak
+peak estimate (NPKI)
+
+Description: This function recursively updates the adaptive noise and signal thresholds in
+the Integrated signal. Implements Eq 12-16.
+
+**********************************************************************************/
+void UpdateThI( pt_level_t *PEAKI, int8_t NOISE_F)
+{
+	// ------ Update Noise & Signal Estimate ------ //
+	if (NOISE_F) {
+		PT_dptr->NPKI -= PT_dptr->NPKI >> 3;
+		PT_dptr->NPKI += *PEAKI >> 3;
+	}
+	else {
+		PT_dptr->SPKI -= PT_dptr->SPKI >> 3;
+		PT_dptr->SPKI += *PEAKI >> 3;
+	}
+
+	// --------- Update Thresholds ---------------- //
+	PT_dptr->ThI1 = PT_dptr->NPKI + ((pt_acc_t) (PT_dptr->SPKI - PT_dptr->NPKI) >> 2);
+	PT_dptr->ThI2 = PT_dptr->ThI1 >> 1;
+}
+
+
+/**********************************************************************************
+
+Fuction Name: UpdateThF
+
+Parameter:
+Input	:	PEAKF	- Pointer to the overal peak
+			NOISE_F	- Flag that indicates whether the peak is noise or not.
+
+Returns	:	none	- Recieves PEAKF and updates Signal peak estimate in BP signal(SPKF), Noise peak
+peak estimate (NPKF)
+
+Description: This function recursively updates the adaptive noise and signal thresholds in 
+the BP signal. Implements Eq 17-21.
+
+**********************************************************************************/
+void UpdateThF(pt_sample_t *PEAKF, int8_t NOISE_F)
+{
+	// ------ Update Noise & Signal Estimate ------ //
+	if (NOISE_F) {
+		PT_dptr->NPKF -= PT_dptr->NPKF >> 3;
+		PT_dptr->NPKF += *PEAKF >> 3;
+	}
+	else {
+		PT_dptr->SPKF -= PT_dptr->SPKF >> 3;
+		PT_dptr->SPKF += *PEAKF >> 3;
+	}
+
+	// --------- Update Thresholds ---------------- //
+	PT_dptr->ThF1 = PT_dptr->NPKF + ((PT_dptr->SPKF - PT_dptr->NPKF) >> 2);
+	PT_dptr->ThF2 = PT_dptr->ThF1 >> 1;
+}
+
+
+#if (PT_HRV == 1)
+/**********************************************************************************
+
+Fuction Name: HRVUpdate
+
+Parameter:
+Input	:	qrs		- The most recent RR interval.
+
+Returns	:	none	- Updates the running sums of the HRV window (HRV_data).
+
+Description: Time-domain heart-rate variability over a window of PT_HRV_WINDOW samples
+sliding with the beats. Running sums are kept, sum and sum of squares of the RR intervals
+for SDNN and of the successive differences for RMSSD, plus the count of differences above
+50 msec for pNN50. The intervals of the window are kept in a ring (as HRSTAT_data does
+for the beats) and the oldest ones are subtracted from the sums once they leave the
+window (HRVExpire), O(1) per beat. With PT_HRV_SKIP_IRREGULAR, intervals flagged as
+irregular by UpdateRR are excluded and break the chain of successive differences.
+
+**********************************************************************************/
+void HRVUpdate(int16_t qrs)
+{
+	int16_t diff = -1;
+	uint8_t used = 0;
+	uint16_t i;
+
+#if (PT_HRV_SKIP_IRREGULAR == 1)
+	if (PT_dptr->HR_State == IRREGULAR_HR)
+		HRV_data.Prev_RR = 0;
+	else
+#endif
+	{
+		used = 1;
+		++HRV_data.N;
+		HRV_data.Sum += qrs;
+		HRV_data.Sum_sq += (uint32_t) qrs * qrs;
+
+		// ---- Successive differences for RMSSD and pNN50 ---- //
+		if (HRV_data.Prev_RR) {
+			diff = qrs - HRV_data.Prev_RR;
+			if (diff < 0) diff = -diff;
+			++HRV_data.N_diff;
+			HRV_data.Sum_diff_sq += (uint32_t) diff * diff;
+			if (diff > HRV_NN50) ++HRV_data.NN50;
+		}
+		HRV_data.Prev_RR = qrs;
+	}
+
+	// ---- Into the ring, a full ring drops its oldest interval ---- //
+	if (HRV_data.Count == PT_HRV_BUFFER_SIZE)
+		HRVExpire();
+	i = (HRV_data.Head + HRV_data.Count++) & (PT_HRV_BUFFER_SIZE - 1);
+	HRV_data.RR[i] = qrs;
+	HRV_data.Diff[i] = diff;
+	HRV_data.Used[i] = used;
+	HRV_data.Win_Len += qrs;
+
+	// ---- Slide, intervals beyond PT_HRV_WINDOW leave the sums ---- //
+	if (HRV_data.Win_Len >= PT_HRV_WINDOW)
+		HRV_data.Full = 1;
+	while (HRV_data.Win_Len > PT_HRV_WINDOW && HRV_data.Count)
+		HRVExpire();
+}
+
+/************************************
+Removes the oldest interval of the HRV
+window from the sums, with the successive
+difference of the next interval to it.
+*************************************/
+void HRVExpire(void)
+{
+	uint16_t i = HRV_data.Head, j = (HRV_data.Head + 1) & (PT_HRV_BUFFER_SIZE - 1);
+	int16_t rr = HRV_data.RR[i], diff;
+
+	HRV_data.Win_Len -= rr;
+	if (HRV_data.Used[i]) {
+		--HRV_data.N;
+		HRV_data.Sum -= rr;
+		HRV_data.Sum_sq -= (uint32_t) rr * rr;
+	}
+
+	if (HRV_data.Count > 1 && (diff = HRV_data.Diff[j]) >= 0) {
+		--HRV_data.N_diff;
+		HRV_data.Sum_diff_sq -= (uint32_t) diff * diff;
+		if (diff > HRV_NN50) --HRV_data.NN50;
+		HRV_data.Diff[j] = -1;
+	}
+
+	HRV_data.Head = j;
+	if (--HRV_data.Count == 0)
+		HRV_data.Prev_RR = 0;							// No successive difference across an empty window
+}
+
+
+/**********************************************************************************
+
+Fuction Name: HRVStats
+
+Parameter:
+Input	:	hrv		- Running sums of an HRV window.
+			stats	- Pointer to the statistics.
+
+Returns	:	none	- Fills stats, intervals in msec and pNN50 in 0.01 %.
+
+Description: Computes MeanNN, SDNN, RMSSD and pNN50 from the running sums. Standard
+deviations are computed in samples with 8 fractional bits before conversion to msec.
+
+**********************************************************************************/
+void HRVStats(const struct PT_hrv_struct *hrv, struct PT_hrv_stats *stats)
+{
+	uint64_t var;
+
+	memset(stats, 0, sizeof(*stats));
+	stats->Beats = hrv->N;
+	if (!hrv->N)
+		return;
+
+	stats->MeanNN = (uint16_t) (((uint64_t) hrv->Sum * 1000) / ((uint32_t) PT_FS * hrv->N));
+
+	// ---- N^2 * variance = N * sum(RR^2) - sum(RR)^2 ---- //
+	var = (uint64_t) hrv->N * hrv->Sum_sq - (uint64_t) hrv->Sum * hrv->Sum;
+	var = (var << 16) / ((uint32_t) hrv->N * hrv->N);
+	stats->SDNN = (uint16_t) (((ISqrt(var) * 1000) / PT_FS) >> 8);
+
+	if (hrv->N_diff) {
+		var = ((uint64_t) hrv->Sum_diff_sq << 16) / hrv->N_diff;
+		stats->RMSSD = (uint16_t) (((ISqrt(var) * 1000) / PT_FS) >> 8);
+		stats->pNN50 = (uint16_t) (((uint32_t) hrv->NN50 * 10000) / hrv->N_diff);
+	}
+}
+#endif
+
+#if (PT_HRV == 1 || PT_TEMPLATE == 1)
+/**********************************************************************************
+
+Fuction Name: ISqrt
+
+Parameter:
+Input	:	x		- Unsigned value.
+
+Returns	:	r		- floor(sqrt(x)).
+
+Description: Bitwise integer square root, only shifts and additions.
+
+**********************************************************************************/
+uint32_t ISqrt(uint64_t x)
+{
+	uint64_t r = 0, bit = (uint64_t) 1 << 62;
+
+	while (bit > x) bit >>= 2;
+	while (bit) {
+		if (x >= r + bit) {
+			x -= r + bit;
+			r = (r >> 1) + bit;
+		}
+		else
+			r >>= 1;
+		bit >>= 2;
+	}
+	return ((uint32_t) r);
+}
+#endif
+
+
+#if (PT_LFHF == 1)
+/**********************************************************************************
+
+Fuction Name: LFHFUpdate
+
+Parameter:
+Input	:	qrs		- The most recent RR interval.
+
+Returns	:	none	- Passes the resampled RR series to LFHFPoint.
+
+Description: Resamples the RR tachogram on a uniform grid of LFHF_STEP samples (4 Hz).
+The tachogram is linearly interpolated between the previous and the current beat, the
+value of each beat being its RR interval. With PT_HRV_SKIP_IRREGULAR, an irregular
+interval holds the previous value so the time axis is kept.
+
+**********************************************************************************/
+void LFHFUpdate(int16_t qrs)
+{
+	int16_t rr = qrs;
+
+	if (!LFHF_data.Prev_RR) {
+		LFHF_data.Prev_RR = qrs;
+		return;
+	}
+#if (PT_HRV_SKIP_IRREGULAR == 1)
+	if (PT_dptr->HR_State == IRREGULAR_HR)
+		rr = LFHF_data.Prev_RR;
+#endif
+
+	// ---- Grid points between the previous and the current beat ---- //
+	while (LFHF_data.Phase < qrs) {
+		LFHFPoint((LFHF_data.Prev_RR << 4) +
+			(int16_t) ((((int32_t) (rr - LFHF_data.Prev_RR) << 4) * LFHF_data.Phase) / qrs));
+		LFHF_data.Phase += LFHF_STEP;
+	}
+	LFHF_data.Phase -= qrs;
+	LFHF_data.Prev_RR = rr;
+}
+
+
+/**********************************************************************************
+
+Fuction Name: LFHFPoint
+
+Parameter:
+Input	:	val		- Resampled RR (samples in Q4).
+
+Returns	:	none	- Updates the Goertzel bank, LFHF_last once the block is complete.
+
+Description: Runs one Goertzel iteration for each bin of the LF and HF bands,
+s[n] = x[n] + 2cos(w)s[n-1] - s[n-2]. After LFHF_N points the power of every bin,
+|X|^2 = s1^2 + s2^2 - 2cos(w)s1s2, is summed per band and scaled by 2/N^2 to the
+variance in msec^2. The first point of a block is removed from the input to keep the
+states small, this does not change the power of bins other than DC.
+
+**********************************************************************************/
+void LFHFPoint(int16_t val)
+{
+	int16_t k;
+	int32_t s;
+	int64_t pw;
+	uint64_t lf = 0, hf = 0;
+
+	if (!LFHF_data.N)
+		LFHF_data.Offset = val;
+	val -= LFHF_data.Offset;
+
+	for (k = 0; k < LFHF_BINS; k++) {
+		s = val + (int32_t) (((int64_t) LFHF_coef[k] * LFHF_data.S1[k]) >> 14) - LFHF_data.S2[k];
+		LFHF_data.S2[k] = LFHF_data.S1[k];
+		LFHF_data.S1[k] = s;
+	}
+
+	if (++LFHF_data.N < LFHF_N)
+		return;
+
+	// ---- Block complete, power per band ---- //
+	for (k = 0; k < LFHF_BINS; k++) {
+		pw = (int64_t) LFHF_data.S1[k] * LFHF_data.S1[k] + (int64_t) LFHF_data.S2[k] * LFHF_data.S2[k]
+			- ((((int64_t) LFHF_coef[k] * LFHF_data.S1[k]) >> 14) * LFHF_data.S2[k]);
+		if (pw < 0) pw = 0;
+		if (k < LFHF_LF_BINS) lf += (uint64_t) pw;
+		else hf += (uint64_t) pw;
+	}
+
+	// ---- 2/N^2 for the one-sided spectrum, 2^8 for Q4, (1000/PT_FS)^2 for msec ---- //
+	lf = ((lf * 1000 / PT_FS) * 1000 / PT_FS) / (((uint32_t) LFHF_N * LFHF_N) << 7);
+	hf = ((hf * 1000 / PT_FS) * 1000 / PT_FS) / (((uint32_t) LFHF_N * LFHF_N) << 7);
+	LFHF_last.LF = (uint32_t) lf;
+	LFHF_last.HF = (uint32_t) hf;
+	LFHF_last.Ratio = hf ? (uint16_t) (lf >= (hf << 8) ? UINT16_MAX : (lf << 8) / hf) : 0;
+
+	memset(LFHF_data.S1, 0, sizeof(LFHF_data.S1));
+	memset(LFHF_data.S2, 0, sizeof(LFHF_data.S2));
+	LFHF_data.N = 0;
+}
+#endif
+
+
+#if (PT_HRSTAT == 1)
+/**********************************************************************************
+
+Fuction Name: HRStatUpdate
+
+Parameter:
+Input	:	qrs		- The most recent RR interval.
+
+Returns	:	none	- Adds the beat to the history and to every window.
+
+Description: Rolling heart-rate statistics over the windows of HRSTAT_win_len. Each
+window keeps a 1 bpm histogram for percentiles and two monotone deques for minimum
+and maximum. As heart rates are integers, a monotone deque holds at most HRSTAT_BINS
+beats whatever the window length. Beats leave a window when older than its length
+(see HRStatExpire), so all updates are O(1) amortized per beat. The beat history is
+shared by the windows and holds PT_HRSTAT_BUFFER_SIZE beats, older beats leave all
+windows even if the window is not over.
+
+**********************************************************************************/
+void HRStatUpdate(int16_t qrs)
+{
+	struct PT_hrstat_win *win;
+	uint32_t seq = HRSTAT_data.Seq;
+	uint16_t hr, idex;
+	int16_t w;
+
+	hr = (PT_RR_to_HR(qrs) + (1 << (HR_Q - 1))) >> HR_Q;
+	if (hr > HRSTAT_BINS - 1) hr = HRSTAT_BINS - 1;
+
+	HRSTAT_data.Time[seq & (PT_HRSTAT_BUFFER_SIZE - 1)] = Sample_Clock;
+	HRSTAT_data.HR[seq & (PT_HRSTAT_BUFFER_SIZE - 1)] = (uint8_t) hr;
+	HRSTAT_data.Seq = seq + 1;
+
+	for (w = 0; w < HRSTAT_WINDOWS; w++) {
+		win = &HRSTAT_data.Win[w];
+
+		// ---- Max deque: drop beats not taller than the new one ---- //
+		while (win->Max_n) {
+			idex = (win->Max_h + win->Max_n - 1) & (HRSTAT_BINS - 1);
+			if (HRSTAT_data.HR[win->Max_q[idex] & (PT_HRSTAT_BUFFER_SIZE - 1)] > hr) break;
+			--win->Max_n;
+		}
+		win->Max_q[(win->Max_h + win->Max_n++) & (HRSTAT_BINS - 1)] = seq;
+
+		// ---- Min deque: drop beats not lower than the new one ---- //
+		while (win->Min_n) {
+			idex = (win->Min_h + win->Min_n - 1) & (HRSTAT_BINS - 1);
+			if (HRSTAT_data.HR[win->Min_q[idex] & (PT_HRSTAT_BUFFER_SIZE - 1)] < hr) break;
+			--win->Min_n;
+		}
+		win->Min_q[(win->Min_h + win->Min_n++) & (HRSTAT_BINS - 1)] = seq;
+
+		++win->Hist[hr];
+		++win->Count;
+		HRStatExpire(win, HRSTAT_win_len[w]);
+	}
+}
+
+
+/**********************************************************************************
+
+Fuction Name: HRStatExpire
+
+Parameter:
+Input	:	win		- Pointer to the window.
+			win_len	- Window length in samples.
+
+Returns	:	none	- Removes the beats older than win_len from the window.
+
+Description: Removes the expired beats from the histogram and from the front of the
+monotone deques. Also removes beats overwritten in the history.
+
+**********************************************************************************/
+void HRStatExpire(struct PT_hrstat_win *win, uint32_t win_len)
+{
+	uint32_t idex;
+
+	while (win->Count) {
+		idex = win->Tail & (PT_HRSTAT_BUFFER_SIZE - 1);
+		if (Sample_Clock - HRSTAT_data.Time[idex] < win_len &&
+			HRSTAT_data.Seq - win->Tail <= PT_HRSTAT_BUFFER_SIZE)
+			break;
+
+		--win->Hist[HRSTAT_data.HR[idex]];
+		--win->Count;
+		if (win->Max_n && win->Max_q[win->Max_h] == win->Tail) {
+			win->Max_h = (win->Max_h + 1) & (HRSTAT_BINS - 1);
+			--win->Max_n;
+		}
+		if (win->Min_n && win->Min_q[win->Min_h] == win->Tail) {
+			win->Min_h = (win->Min_h + 1) & (HRSTAT_BINS - 1);
+			--win->Min_n;
+		}
+		++win->Tail;
+	}
+}
+#endif
+
+
+#if (PT_TREND == 1)
+/**********************************************************************************
+
+Fuction Name: TrendUpdate
+
+Parameter:
+Input	:	qrs		- The most recent RR interval.
+
+Returns	:	none	- Adds the heart rate of the beat to the open 10 sec bucket.
+
+Description: Multi-resolution heart-rate trend. Buckets of 10 sec, 1 min, 10 min and
+1 hour (TREND_len) hold the minimum, mean and maximum heart rate and the number of beats.
+Each level is a fixed ring (TREND_size) so the trend goes back 96 hours. A bucket is
+summarized into the open bucket of the next level once closed, so beats are only
+added once. Buckets are aligned to the sample clock.
+
+**********************************************************************************/
+void TrendUpdate(int16_t qrs)
+{
+	struct PT_trend_bucket beat;
+
+	TrendAdvance();
+
+	beat.Sum = beat.Min = beat.Max = PT_RR_to_HR(qrs);
+	beat.Beats = 1;
+	TrendMerge(&TREND_data.Cur[0], &beat);
+}
+
+
+/**********************************************************************************
+
+Fuction Name: TrendAdvance
+
+Parameter:
+Input	:	none
+
+Returns	:	none	- Closes the buckets that are over.
+
+Description: Closes the open 10 sec bucket(s) up to the sample clock, a closed bucket
+is stored in the ring of its level and merged into the open bucket of the next level,
+which is closed in turn after 6, 10 or 6 buckets. Buckets without beats are closed
+too. Called on every beat and query, so nothing is done per sample.
+
+**********************************************************************************/
+void TrendAdvance(void)
+{
+	int16_t level;
+	struct PT_trend_bucket *cur;
+
+	while (Sample_Clock - TREND_data.Start >= TREND_len[0]) {
+		TREND_data.Start += TREND_len[0];
+
+		for (level = 0; level < TREND_LEVELS; level++) {
+			cur = &TREND_data.Cur[level];
+			TREND_data.Buf[TREND_offset[level] + TREND_data.Closed[level] % TREND_size[level]] = *cur;
+			++TREND_data.Closed[level];
+			if (level + 1 < TREND_LEVELS)
+				TrendMerge(&TREND_data.Cur[level + 1], cur);
+
+			memset(cur, 0, sizeof(*cur));
+			cur->Min = UINT16_MAX;
+
+			// ---- Is the next level bucket over as well ---- //
+			if (level + 1 == TREND_LEVELS || TREND_data.Start % TREND_len[level + 1])
+				break;
+		}
+	}
+}
+
+
+/**********************************************************************************
+
+Fuction Name: TrendMerge
+
+Parameter:
+Input	:	dst		- Pointer to the bucket to update.
+			src		- Pointer to the bucket to add.
+
+Returns	:	none	- Adds src to dst.
+
+**********************************************************************************/
+void TrendMerge(struct PT_trend_bucket *dst, const struct PT_trend_bucket *src)
+{
+	if (!src->Beats)
+		return;
+	dst->Sum += src->Sum;
+	dst->Beats += src->Beats;
+	if (src->Min < dst->Min) dst->Min = src->Min;
+	if (src->Max > dst->Max) dst->Max = src->Max;
+}
+#endif
+
+
+#if (PT_ALARM == 1)
+/**********************************************************************************
+
+Fuction Name: AlarmUpdate
+
+Parameter:
+Input	:	BeatDelay	- Beat delay returned by PT_StateMachine, 0 if no beat.
+
+Returns	:	none		- Raises and clears the alarms.
+
+Description: Evaluates the alarms once per sample. Without a beat only the asystole
+counter is checked. On a beat asystole is cleared, bradycardia and tachycardia are
+evaluated on the heart rate of the most recent RR mean (Recent_RR_M) and irregular
+rhythm on an up-down count of the beats flagged irregular by UpdateRR. Each alarm has
+separate raise and clear levels (ALARM_config) so it does not toggle around a limit.
+The counters are not reset by the emergency reset of the detector.
+
+**********************************************************************************/
+void AlarmUpdate(int16_t BeatDelay)
+{
+	int16_t hr;
+
+	// ---- No beat, only asystole ---- //
+	if (!BeatDelay) {
+		if (ALARM_data.Since_Beat < INT16_MAX)
+			++ALARM_data.Since_Beat;
+		if (ALARM_data.Since_Beat > ALARM_config.Asystole)
+			AlarmSet(ALARM_ASYSTOLE, 1);
+		return;
+	}
+
+	ALARM_data.Since_Beat = BeatDelay;
+	AlarmSet(ALARM_ASYSTOLE, 0);
+
+	// ---- Rate alarms ---- //
+	hr = (int16_t) ((PT_get_ShortTimeHRQ_output() + (1 << (HR_Q - 1))) >> HR_Q);
+	if (hr < ALARM_config.Brady_On)
+		AlarmSet(ALARM_BRADY, 1);
+	else if (hr > ALARM_config.Brady_Off)
+		AlarmSet(ALARM_BRADY, 0);
+
+	if (hr > ALARM_config.Tachy_On)
+		AlarmSet(ALARM_TACHY, 1);
+	else if (hr < ALARM_config.Tachy_Off)
+		AlarmSet(ALARM_TACHY, 0);
+
+	// ---- Rhythm alarm ---- //
+	if (PT_dptr->HR_State == IRREGULAR_HR) {
+		if (ALARM_data.Irregular_Cnt < ALARM_config.Irregular_On)
+			++ALARM_data.Irregular_Cnt;
+	}
+	else if (ALARM_data.Irregular_Cnt > 0)
+		--ALARM_data.Irregular_Cnt;
+
+	if (ALARM_data.Irregular_Cnt >= ALARM_config.Irregular_On)
+		AlarmSet(ALARM_IRREGULAR, 1);
+	else if (ALARM_data.Irregular_Cnt <= ALARM_config.Irregular_Off)
+		AlarmSet(ALARM_IRREGULAR, 0);
+}
+
+
+/**********************************************************************************
+
+Fuction Name: AlarmSet
+
+Parameter:
+Input	:	alarm	- ALARM_ASYSTOLE, ALARM_BRADY, ALARM_TACHY or ALARM_IRREGULAR.
+			raised	- 1 to raise, 0 to clear.
+
+Returns	:	none	- Queues an event if the state of the alarm changes.
+
+Description: Updates the alarm state and queues the change. If the queue is full the
+oldest event is dropped and counted in Lost.
+
+**********************************************************************************/
+void AlarmSet(int16_t alarm, int16_t raised)
+{
+	struct PT_alarm_event *ev;
+
+	if (!(ALARM_data.State & alarm) == !raised)
+		return;
+
+	if (raised)
+		ALARM_data.State |= alarm;
+	else
+		ALARM_data.State &= ~alarm;
+
+	if (ALARM_data.Count == ALARM_QUEUE_SIZE) {
+		ALARM_data.Head = (ALARM_data.Head + 1) & (ALARM_QUEUE_SIZE - 1);
+		--ALARM_data.Count;
+		++ALARM_data.Lost;
+	}
+	ev = &ALARM_data.Queue[(ALARM_data.Head + ALARM_data.Count++) & (ALARM_QUEUE_SIZE - 1)];
+	ev->Time = Sample_Clock;
+	ev->Alarm = alarm;
+	ev->Raised = raised;
+}
+#endif
+
+
+#if (PT_SQI == 1)
+/**********************************************************************************
+
+Fuction Name: SQIUpdate
+
+Parameter:
+Input	:	datum	- Most recent sample of ECG from ADC.
+
+Returns	:	none	- Updates the lead status (SQI_data.Status) once per second.
+
+Description: Computes a cheap signal quality index over blocks of PT1000MS samples, the
+input range for a flat lead, the samples at the ADC rails for a saturated lead and the
+ratio of the derivative to the BP signal energy (sum of absolute values of DRF_val and
+HPF_val) for a lead dominated by noise. One bad block makes the lead unusable, it is
+usable again after SQI_GOOD_BLOCKS good blocks. While the lead is unusable PT_StateMachine
+only runs the filters, so neither thresholds nor RR intervals learn from it and the
+emergency reset is not triggered. A provisional beat still pending when the lead goes bad
+is retracted on that sample (PT_LOW_LATENCY).
+
+**********************************************************************************/
+void SQIUpdate(pt_sample_t datum)
+{
+	int16_t status;
+
+	if (datum < SQI_data.Min) SQI_data.Min = datum;
+	if (datum > SQI_data.Max) SQI_data.Max = datum;
+	if (datum >= SQI_RAIL_HIGH || datum <= SQI_RAIL_LOW) ++SQI_data.Rail_Cnt;
+	SQI_data.Sum_HP += (PT_dptr->HPF_val < 0) ? -PT_dptr->HPF_val : PT_dptr->HPF_val;
+	SQI_data.Sum_DR += (PT_dptr->DRF_val < 0) ? -PT_dptr->DRF_val : PT_dptr->DRF_val;
+
+	if (++SQI_data.Cnt < PT1000MS)
+		return;
+
+	// ---- Block complete, classify the lead ---- //
+	SQI_data.Noise = SQI_data.Sum_HP ? (uint16_t) (((uint64_t) SQI_data.Sum_DR << 8) / SQI_data.Sum_HP) : 0;
+
+	if (SQI_data.Rail_Cnt >= (PT1000MS >> 1))
+		status = LEAD_SATURATED;
+	else if (SQI_data.Max - SQI_data.Min <= SQI_FLAT_RANGE)
+		status = LEAD_FLAT;
+	else if (SQI_data.Noise > SQI_NOISE_LIM)
+		status = LEAD_NOISY;
+	else
+		status = LEAD_OK;
+
+	if (status != LEAD_OK) {
+		if (SQI_data.Status == LEAD_OK) {
+#if (PT_LOW_LATENCY == 1)
+			Prov_Lost = Prov_Pending;
+			Prov_Pending = 0;
+#endif
+#if (PT_ALARM == 1)
+			AlarmSet(ALARM_LEAD_OFF, 1);
+#endif
+		}
+		SQI_data.Status = status;
+		SQI_data.Good_Blocks = 0;
+	}
+	else if (SQI_data.Status != LEAD_OK && ++SQI_data.Good_Blocks >= SQI_GOOD_BLOCKS) {
+		SQI_data.Status = LEAD_OK;
+		LeadRestored();
+	}
+
+	SQI_data.Sum_HP = SQI_data.Sum_DR = 0;
+	SQI_data.Min = SQI_RAIL_HIGH;
+	SQI_data.Max = SQI_RAIL_LOW;
+	SQI_data.Rail_Cnt = SQI_data.Cnt = 0;
+}
+
+
+/**********************************************************************************
+
+Fuction Name: LeadRestored
+
+Parameter:
+Input	:	none
+
+Returns	:	none	- Restarts the decision logic.
+
+Description: Called when the lead becomes usable again. Peaks stored before the lead
+was lost are dropped and the decision logic restarts (DecisionRestart), so the next
+beat does not produce an RR interval spanning the lost period.
+
+**********************************************************************************/
+void LeadRestored(void)
+{
+	DecisionRestart(0);
+
+#if (PT_ALARM == 1)
+	AlarmSet(ALARM_LEAD_OFF, 0);
+#endif
+}
+#endif
+
+#if (PT_SQI == 1 || PT_GAP == 1)
+/**********************************************************************************
+
+Fuction Name: DecisionRestart
+
+Parameter:
+Input	:	keep_rr	- Non-zero to keep Count_SinceRR and the state.
+
+Returns	:	none	- Drops the held peaks and restarts the decision logic.
+
+Description: Shared by LeadRestored and PT_Gap. Peaks held for the blanking time or
+the search-back are dropped, a provisional beat waiting for them is retracted by the
+next decision (PT_LOW_LATENCY). Unless keep_rr the RR count starts over: if learning
+was over the thresholds are kept and the state goes back to LEARN_PH_2, otherwise
+learning starts over.
+
+**********************************************************************************/
+void DecisionRestart(int16_t keep_rr)
+{
+	BlankTimeCnt = 0;
+	Best_PeakBP = Best_PeakDR = 0;
+	SBcntI = 0;
+	SB_peakI = 0;
+	SB_peakBP = SB_peakDR = 0;
+#if (PT_LOW_LATENCY == 1)
+	Prov_Lost |= Prov_Pending;
+	Prov_Pending = 0;
+#endif
+
+	if (keep_rr)
+		return;
+
+	Count_SinceRR = 0;
+	if (PT_dptr->PT_state >= LEARN_PH_2)
+		PT_dptr->PT_state = LEARN_PH_2;
+	else {
+		PT_dptr->PT_state = START_UP;
+		st_mx_pk = 0;
+	}
+#if (PT_ALARM == 1)
+	ALARM_data.Since_Beat = 0;
+#endif
+}
+#endif
+
+#if (PT_AGC == 1)
+/**********************************************************************************
+
+Fuction Name: AGCUpdate
+
+Parameter:
+Input	:	datum	- Pointer to the most recent sample of ECG from ADC.
+
+Returns	:	none	- Applies the gain to datum in place.
+
+Description: Automatic gain control in front of LPFilter. The envelope of the
+derivative (max |DRF_val|) is measured over blocks of AGC_BLOCK samples. The gain is
+halved until the envelope is below AGC_HIGH, i.e. clear of the SQR_LIM_VAL clamp, and
+doubled after AGC_UP_BLOCKS blocks below AGC_LOW. Each step rescales the filters and
+thresholds (see AGCRescale) so detection goes on as if the gain had always been used.
+A step down during LEARN_PH_1 starts the learning over since the peaks were clamped.
+The gain is not raised while the lead is unusable (PT_SQI), an overdriven lead
+looks noisy and still has to be gained down.
+
+**********************************************************************************/
+void AGCUpdate(pt_sample_t *datum)
+{
+	pt_sample_t env;
+
+	// ---- Envelope of the previous sample, at the current gain ---- //
+	env = (PT_dptr->DRF_val < 0) ? -PT_dptr->DRF_val : PT_dptr->DRF_val;
+	if (env > AGC_data.Env) AGC_data.Env = env;
+
+	if (++AGC_data.Cnt == AGC_BLOCK) {
+		if (AGC_data.Env > AGC_HIGH && AGC_data.Shift > AGC_SHIFT_MIN) {
+			// ---- As many steps down as the envelope needs ---- //
+			do {
+				AGCRescale(0);
+				--AGC_data.Shift;
+				AGC_data.Env >>= 1;
+			} while (AGC_data.Env > AGC_HIGH && AGC_data.Shift > AGC_SHIFT_MIN);
+			AGC_data.Quiet_Blocks = 0;
+
+			// ---- Peaks learnt so far were clamped, learn again ---- //
+			if (PT_dptr->PT_state == LEARN_PH_1) {
+				PT_dptr->PT_state = START_UP;
+				st_mx_pk = 0;
+				Count_SinceRR = 0;
+			}
+		}
+#if (PT_SQI == 1)
+		else if (SQI_data.Status != LEAD_OK)
+			AGC_data.Quiet_Blocks = 0;
+#endif
+		else if (AGC_data.Env < AGC_LOW && AGC_data.Shift < AGC_SHIFT_MAX) {
+			if (++AGC_data.Quiet_Blocks >= AGC_UP_BLOCKS) {
+				AGCRescale(1);
+				++AGC_data.Shift;
+				AGC_data.Quiet_Blocks = 0;
+			}
+		}
+		else
+			AGC_data.Quiet_Blocks = 0;
+
+		AGC_data.Env = 0;
+		AGC_data.Cnt = 0;
+	}
+
+	*datum = AGCScale(*datum, AGC_data.Shift);
+}
+
+
+/**********************************************************************************
+
+Fuction Name: AGCRescale
+
+Parameter:
+Input	:	up		- 1 to double the gain, 0 to halve it.
+
+Returns	:	none	- Rescales filter buffers, peaks and thresholds in place.
+
+Description: The input, BP and derivative values scale with the gain and the squared
+and integrated values with its square. The raw samples and the LP outputs in the filter
+buffers are rescaled and the recursive states (LP_y_old, LP_y_new, y_h and MV_sum) are
+recomputed from them, otherwise the rounding of a halving would leave the integrators
+with a drift. Doubling is exact.
+
+**********************************************************************************/
+void AGCRescale(int16_t up)
+{
+	int16_t idex;
+	int32_t w_old, w_new, h_sum;
+	uint64_t mv_sum;
+	int16_t s1 = up ? 1 : -1;
+	int16_t s2 = up ? 2 : -2;
+
+	// ---- Filter buffers ---- //
+	for (idex = 0; idex < LP_BUFFER_SIZE; idex++)
+		AGC_LP_X(idex) = AGCScale(AGC_LP_X(idex), s1);
+	for (idex = 0; idex < HP_BUFFER_SIZE; idex++)
+		AGC_HP_X(idex) = AGCScale(AGC_HP_X(idex), s1);
+	for (idex = 0; idex < DR_BUFFER_SIZE; idex++)
+		PT_dptr->DR_buf[idex] = AGCScale(PT_dptr->DR_buf[idex], s1);
+
+	// ---- LP state, w[n] = sum h[k] x[n - k] with h = 1 2 3 4 5 6 5 4 3 2 1 ---- //
+	w_old = w_new = 0;
+	for (idex = 0; idex < LP_BUFFER_SIZE - 1; idex++) {
+		w_old += (int32_t) (idex < 6 ? idex + 1 : 11 - idex) * AGC_LP_X(idex);
+		w_new += (int32_t) (idex < 6 ? idex + 1 : 11 - idex) * AGC_LP_X(idex + 1);
+	}
+	LP_y_old = (pt_sample_t) w_old;
+	LP_y_new = (pt_sample_t) w_new;
+
+	// ---- HP state, y_h[n] = x[n - 16] - sum x[n - k]/32, k = 0 - 31 ---- //
+	h_sum = 0;
+	for (idex = 0; idex < HP_BUFFER_SIZE; idex++)
+		h_sum += AGC_HP_X(idex) >> 5;
+	y_h = (pt_sample_t) (AGC_HP_X(HP_BUFFER_SIZE >> 1) - h_sum);
+
+	// ---- Integrated signal ---- //
+	mv_sum = 0;
+	for (idex = 0; idex < MVA_BUFFER_SIZE; idex++) {
+		PT_dptr->MVA_buf[idex] = AGCScaleLevel(PT_dptr->MVA_buf[idex], s2);
+		if (PT_dptr->MVA_buf[idex] > SQR_LIM_OUT)
+			PT_dptr->MVA_buf[idex] = SQR_LIM_OUT;
+		mv_sum += PT_dptr->MVA_buf[idex];
+	}
+	MV_sum = (mv_sum > PT_LEVEL_MAX) ? PT_LEVEL_MAX : (pt_level_t) mv_sum;
+
+	// ---- Current values, peaks and thresholds of the BP and derivative signals ---- //
+	PT_dptr->LPF_val = AGCScale(PT_dptr->LPF_val, s1);
+	PT_dptr->HPF_val = AGCScale(PT_dptr->HPF_val, s1);
+	PT_dptr->DRF_val = AGCScale(PT_dptr->DRF_val, s1);
+	PT_dptr->SPKF = AGCScale(PT_dptr->SPKF, s1);
+	PT_dptr->NPKF = AGCScale(PT_dptr->NPKF, s1);
+	PT_dptr->ThF1 = AGCScale(PT_dptr->ThF1, s1);
+	PT_dptr->ThF2 = AGCScale(PT_dptr->ThF2, s1);
+	Prev_valBP = AGCScale(Prev_valBP, s1);
+	Prev_Prev_valBP = AGCScale(Prev_Prev_valBP, s1);
+	Best_PeakBP = AGCScale(Best_PeakBP, s1);
+	SB_peakBP = AGCScale(SB_peakBP, s1);
+	st_mean_pkBP = AGCScale(st_mean_pkBP, s1);
+	Prev_valDR = AGCScale(Prev_valDR, s1);
+	Prev_Prev_valDR = AGCScale(Prev_Prev_valDR, s1);
+	Best_PeakDR = AGCScale(Best_PeakDR, s1);
+	Old_PeakDR = AGCScale(Old_PeakDR, s1);
+	SB_peakDR = AGCScale(SB_peakDR, s1);
+
+	// ---- Current values, peaks and thresholds of the integrated signal ---- //
+	PT_dptr->SQF_val = AGCScaleLevel(PT_dptr->SQF_val, s2);
+	PT_dptr->MVA_val = AGCScaleLevel(PT_dptr->MVA_val, s2);
+	if (PT_dptr->MVA_val > MVA_LIM_VAL)
+		PT_dptr->MVA_val = MVA_LIM_VAL;
+	PT_dptr->SPKI = AGCScaleLevel(PT_dptr->SPKI, s2);
+	PT_dptr->NPKI = AGCScaleLevel(PT_dptr->NPKI, s2);
+	PT_dptr->ThI1 = AGCScaleLevel(PT_dptr->ThI1, s2);
+	PT_dptr->ThI2 = AGCScaleLevel(PT_dptr->ThI2, s2);
+	Prev_val = AGCScaleLevel(Prev_val, s2);
+	Prev_Prev_val = AGCScaleLevel(Prev_Prev_val, s2);
+	PEAKI_temp = AGCScaleLevel(PEAKI_temp, s2);
+	SB_peakI = AGCScaleLevel(SB_peakI, s2);
+	st_mx_pk = AGCScaleLevel(st_mx_pk, s2);
+	st_mean_pk = AGCScaleLevel(st_mean_pk, s2);
+}
+
+
+/**********************************************************************************
+
+Fuction Name: AGCScale, AGCScaleLevel
+
+Parameter:
+Input	:	val		- BP (AGCScale) or integrated (AGCScaleLevel) value.
+			shift	- Power of two to scale val with, negative to divide.
+
+Returns	:	val * 2^shift, saturated to the range of the type.
+
+**********************************************************************************/
+pt_sample_t AGCScale(pt_sample_t val, int16_t shift)
+{
+	if (shift < 0)
+		return (val >> -shift);
+	if (val > (PT_SAMPLE_MAX >> shift))
+		return (PT_SAMPLE_MAX);
+	if (val < (PT_SAMPLE_MIN >> shift))
+		return (PT_SAMPLE_MIN);
+	return (val * ((pt_sample_t) 1 << shift));
+}
+
+pt_level_t AGCScaleLevel(pt_level_t val, int16_t shift)
+{
+	if (shift < 0)
+		return (val >> -shift);
+	if (val > (PT_LEVEL_MAX >> shift))
+		return (PT_LEVEL_MAX);
+	return (val << shift);
+}
+#endif
+
+#if (PT_PREPROC == 1)
+/**********************************************************************************
+
+Fuction Name: Preprocess
+
+Parameter:
+Input	:	datum	- Pointer to the most recent sample of ECG from ADC.
+
+Returns	:	none	- Filters datum in place.
+
+Description: Stages selected with PT_set_Preprocess, run in front of LPFilter.
+The baseline wander blocker y[n] = x[n] - x[n-1] + (1 - 2^-PRE_BASE_SHIFT) y[n-1]
+keeps its output in Q(PRE_BASE_SHIFT) so the rounding does not build up a DC offset.
+It also keeps the DC of the input out of LPFilter. The notches are 3-tap FIR filters
+with zeros at 50 Hz (x[n] + x[n-2]) / 2 and 60 Hz (x[n] + 0.618 x[n-1] + x[n-2]) / 2.618
+for PT_FS = 200 Hz, unity gain at DC and a delay of 1 sample each (see PT_DELAY).
+
+**********************************************************************************/
+void Preprocess(pt_sample_t *datum)
+{
+	pt_acc_t y = *datum;
+	pt_sample_t x;
+
+	// ---- Start from the first sample, a DC offset would reach the detector as a step ---- //
+	if (!PRE_data.Primed) {
+		PRE_data.Base_x = *datum;
+		PRE_data.N50_x[0] = PRE_data.N50_x[1] = PRE_data.N60_x[0] = PRE_data.N60_x[1] = *datum;
+		PRE_data.Primed = 1;
+	}
+
+	// ---- Baseline wander ---- //
+	if (PRE_mode & PRE_BASELINE) {
+		PRE_data.Base_acc += (y - PRE_data.Base_x) * ((pt_acc_t) 1 << PRE_BASE_SHIFT) - (PRE_data.Base_acc >> PRE_BASE_SHIFT);
+		PRE_data.Base_x = *datum;
+		y = PRE_data.Base_acc >> PRE_BASE_SHIFT;
+		y = (y > PT_SAMPLE_MAX) ? PT_SAMPLE_MAX : ((y < PT_SAMPLE_MIN) ? PT_SAMPLE_MIN : y);
+	}
+
+	// ---- 50 Hz notch ---- //
+	if (PRE_mode & PRE_NOTCH_50) {
+		x = (pt_sample_t) y;
+		y = (y + PRE_data.N50_x[1]) >> 1;
+		PRE_data.N50_x[1] = PRE_data.N50_x[0];
+		PRE_data.N50_x[0] = x;
+	}
+
+	// ---- 60 Hz notch ---- //
+	if (PRE_mode & PRE_NOTCH_60) {
+		x = (pt_sample_t) y;
+		y = (PRE_NOTCH60_A * (y + PRE_data.N60_x[1]) + PRE_NOTCH60_B * PRE_data.N60_x[0] + (1 << 14)) >> 15;
+		PRE_data.N60_x[1] = PRE_data.N60_x[0];
+		PRE_data.N60_x[0] = x;
+		y = (y > PT_SAMPLE_MAX) ? PT_SAMPLE_MAX : ((y < PT_SAMPLE_MIN) ? PT_SAMPLE_MIN : y);
+	}
+
+	*datum = (pt_sample_t) y;
+}
+#endif
+
+
+#if (PT_R_REFINE == 1)
+/**********************************************************************************
+
+Fuction Name: RPeakRefine
+
+Parameter:
+Input	:	BeatDelay	- Delay returned by BeatDecision for the current beat.
+
+Returns	:	none		- Stores the delay of the R apex in RPK_data.DelayQ.
+
+Description: BeatDelay points at a fixed offset from the integrated-window peak,
+not at the R apex. The apex is taken as the input sample furthest from the mean of
+the RPK_WIN samples on each side of the beat, so negative QRS and DC offsets are
+handled, and a parabola through the apex and its two neighbours gives the fraction
+of a sample. Search-back beats older than the history keep BeatDelay.
+
+**********************************************************************************/
+void RPeakRefine(int16_t BeatDelay)
+{
+	int16_t k, apex;
+	pt_acc_t sum = 0, mean, dev, best = -1, ym, y0, yp, den, frac = 0;
+
+	// ---- Window and the neighbours of its ends must be in the history ---- //
+	if (BeatDelay - RPK_WIN < 1 || BeatDelay + RPK_WIN + 1 >= RPK_RING_SIZE) {
+		RPK_data.DelayQ = (int32_t) BeatDelay << RPK_Q;
+		return;
+	}
+
+	// ---- k samples before the current one ---- //
+#define RPK_X(k)			((pt_acc_t) RPK_data.Ring[(uint16_t) (RPK_data.Idx - 1 - (k)) & (RPK_RING_SIZE - 1)])
+	for (k = BeatDelay - RPK_WIN; k <= BeatDelay + RPK_WIN; k++)
+		sum += RPK_X(k);
+	mean = sum / (2 * RPK_WIN + 1);
+
+	apex = BeatDelay;
+	for (k = BeatDelay - RPK_WIN; k <= BeatDelay + RPK_WIN; k++) {
+		dev = RPK_X(k) - mean;
+		if (dev < 0) dev = -dev;
+		if (dev > best) {
+			best = dev;
+			apex = k;
+		}
+	}
+
+	// ---- Vertex of the parabola, positive towards the current sample ---- //
+	yp = RPK_X(apex - 1);
+	y0 = RPK_X(apex);
+	ym = RPK_X(apex + 1);
+	den = ym - 2 * y0 + yp;
+	if (den != 0) {
+		frac = ((ym - yp) * ((pt_acc_t) 1 << (RPK_Q - 1))) / den;
+		if (frac > (1 << (RPK_Q - 1))) frac = 1 << (RPK_Q - 1);
+		if (frac < -(1 << (RPK_Q - 1))) frac = -(1 << (RPK_Q - 1));
+	}
+#undef RPK_X
+
+	RPK_data.DelayQ = ((int32_t) apex << RPK_Q) - (int32_t) frac;
+}
+#endif
+
+
+#if (PT_TEMPLATE == 1)
+/**********************************************************************************
+
+Fuction Name: TemplateUpdate
+
+Parameter:
+Input	:	none	- Uses the R apex found by RPeakRefine and the input history.
+
+Returns	:	none	- Updates TPL_data, the cluster and class of the beat.
+
+Description: Takes TPL_LEN samples of the history around the R apex, removes
+their mean and scales them to a peak of TPL_AMP, so only the shape is compared.
+The beat joins the template with the highest correlation if it reaches TPL_MATCH
+and the template moves 1/2^TPL_ADAPT towards it, otherwise it starts a new cluster
+in a free slot or in place of the smallest one. The largest cluster is taken as
+the normal beats once it holds TPL_LEARN beats. At most TPL_COUNT dot products of
+TPL_LEN int16 values per beat.
+
+**********************************************************************************/
+void TemplateUpdate(void)
+{
+	int16_t k, j, apex, best = -1, slot;
+	pt_acc_t sum = 0, mean, peak = 0, d;
+	int32_t energy, dot, corr, best_corr = 0;
+	uint32_t norm;
+
+	TPL_data.Cluster = -1;
+	TPL_data.Corr = 0;
+	TPL_data.Class = CLASS_UNKNOWN;
+
+	// ---- Window from TPL_PRE samples before the apex, k samples before the current one ---- //
+	apex = (int16_t) ((RPK_data.DelayQ + (1 << (RPK_Q - 1))) >> RPK_Q);
+	if (apex - (TPL_LEN - TPL_PRE) < 0 || apex + TPL_PRE >= RPK_RING_SIZE)
+		return;
+#define TPL_X(j)			((pt_acc_t) RPK_data.Ring[(uint16_t) (RPK_data.Idx - 1 - (apex + TPL_PRE - (j))) & (RPK_RING_SIZE - 1)])
+	for (j = 0; j < TPL_LEN; j++)
+		sum += TPL_X(j);
+	mean = sum / TPL_LEN;
+	for (j = 0; j < TPL_LEN; j++) {
+		d = TPL_X(j) - mean;
+		if (d < 0) d = -d;
+		if (d > peak) peak = d;
+	}
+	if (!peak)
+		return;
+	for (j = 0; j < TPL_LEN; j++)
+		TPL_data.Beat[j] = (int16_t) (((TPL_X(j) - mean) * TPL_AMP) / peak);
+#undef TPL_X
+	energy = TemplateDot(TPL_data.Beat, TPL_data.Beat);
+
+	// ---- Closest template ---- //
+	for (k = 0; k < TPL_COUNT; k++) {
+		if (!TPL_data.Count[k])
+			continue;
+		dot = TemplateDot(TPL_data.Beat, TPL_data.Tpl[k]);
+		norm = ISqrt((uint64_t) energy * (uint64_t) TPL_data.Energy[k]);
+		corr = (dot > 0 && norm) ? (int32_t) (((int64_t) dot << 8) / norm) : 0;
+		if (corr > best_corr) {
+			best_corr = corr;
+			best = k;
+		}
+	}
+
+	if (best >= 0 && best_corr >= TPL_MATCH) {
+		// ---- Join the cluster, the template follows slowly ---- //
+		for (j = 0; j < TPL_LEN; j++)
+			TPL_data.Tpl[best][j] += (TPL_data.Beat[j] - TPL_data.Tpl[best][j]) >> TPL_ADAPT;
+		TPL_data.Energy[best] = TemplateDot(TPL_data.Tpl[best], TPL_data.Tpl[best]);
+		if (TPL_data.Count[best] < UINT16_MAX)
+			++TPL_data.Count[best];
+		slot = best;
+	}
+	else {
+		// ---- New cluster in a free slot or in place of the smallest ---- //
+		for (slot = 0, k = 1; k < TPL_COUNT; k++)
+			if (TPL_data.Count[k] < TPL_data.Count[slot])
+				slot = k;
+		memcpy(TPL_data.Tpl[slot], TPL_data.Beat, sizeof(TPL_data.Beat));
+		TPL_data.Energy[slot] = energy;
+		TPL_data.Count[slot] = 1;
+		best_corr = 1 << 8;
+	}
+	TPL_data.Cluster = slot;
+	TPL_data.Corr = (int16_t) best_corr;
+
+	// ---- Largest cluster holds the normal beats ---- //
+	for (best = 0, k = 1; k < TPL_COUNT; k++)
+		if (TPL_data.Count[k] > TPL_data.Count[best])
+			best = k;
+	if (TPL_data.Count[best] >= TPL_LEARN)
+		TPL_data.Class = (slot == best) ? CLASS_NORMAL : CLASS_ECTOPIC;
+}
+
+
+/**********************************************************************************
+
+Fuction Name: TemplateDot
+
+Parameter:
+Input	:	a, b	- TPL_LEN normalized samples.
+
+Returns	:	Sum of a[j] * b[j].
+
+Description: Plain loop over int16 values with an int32 sum so compilers turn it into
+packed multiply-adds. |a|, |b| <= TPL_AMP keeps the sum within 32 bits.
+
+**********************************************************************************/
+int32_t TemplateDot(const int16_t *a, const int16_t *b)
+{
+	int16_t j;
+	int32_t sum = 0;
+
+	for (j = 0; j < TPL_LEN; j++)
+		sum += (int32_t) a[j] * b[j];
+	return (sum);
+}
+#endif
+
+
+#if (PT_GAP == 1)
+/**********************************************************************************
+
+Fuction Name: PT_Gap
+
+Parameter:
+Input	:	n		- Number of missing samples, e.g. of a dropped packet.
+
+Returns	:	none
+
+Description: Declares n samples that will never arrive, instead of feeding zeros (a
+step through the filters that looks like a QRS and drags the noise level) or calling
+PT_init (2 seconds of learning). The sample clock advances by n. Peaks held for the
+blanking time or the search-back are dropped. If no beat is expected within the gap
+(Count_SinceRR + n below RR_Low_L) Count_SinceRR advances too so the next RR interval
+is right, otherwise the thresholds are kept and the detector goes back to LEARN_PH_2
+so no RR interval spans the gap, as after a lost lead (DecisionRestart). The filter
+delay lines are primed with the next sample (GapPrime) and the next GAP_WARMUP samples
+make no decisions. A beat whose decision was still pending when the gap began (the last
+~70 samples before it) is lost with the dropped peaks, a provisional one is retracted
+on the next sample (PT_LOW_LATENCY). Only the input history of PT_R_REFINE costs more
+than O(1), the last sample is held over at most RPK_RING_SIZE missing samples.
+PT_StateMachine only.
+
+**********************************************************************************/
+void PT_Gap(int32_t n)
+{
+#if (PT_R_REFINE == 1)
+	int32_t k;
+#endif
+
+	if (n <= 0)
+		return;
+
+	Sample_Clock += (uint32_t) n;
+
+#if (PT_LOW_LATENCY == 1)
+	if (Prov_Pending)
+		Prov_Delay = (int16_t) ((Prov_Delay + n < INT16_MAX) ? Prov_Delay + n : INT16_MAX - 1);
+#endif
+
+	if ((int32_t) Count_SinceRR + n < PT_dptr->RR_Low_L) {
+		DecisionRestart(1);
+		Count_SinceRR += (int16_t) n;
+#if (PT_ALARM == 1)
+		ALARM_data.Since_Beat += (int16_t) n;
+#endif
+	}
+	else
+		DecisionRestart(0);
+
+#if (PT_R_REFINE == 1)
+	for (k = 0; k < n && k < RPK_RING_SIZE; k++, RPK_data.Idx++)
+		RPK_data.Ring[RPK_data.Idx & (RPK_RING_SIZE - 1)] = RPK_data.Ring[(uint16_t) (RPK_data.Idx - 1) & (RPK_RING_SIZE - 1)];
+#endif
+#if (PT_PREPROC == 1)
+	PRE_data.Primed = 0;
+#endif
+
+	GAP_prime = 1;
+	GAP_warm = GAP_WARMUP;
+}
+
+
+/**********************************************************************************
+
+Fuction Name: GapPrime
+
+Parameter:
+Input	:	x		- First sample after the gap, in front of LPFilter.
+
+Returns	:	none	- Fills the filter delay lines.
+
+Description: Sets the LP and HP filters to their steady state for a constant input x
+(LP gain 36 at DC, HP output 0), so the level change over the gap is no step. The
+derivative, squaring and MVA filters start from zero. With FILTER_FORM 1 or user
+filter stages the delay lines are cleared instead.
+
+**********************************************************************************/
+void GapPrime(pt_sample_t x)
+{
+	int16_t idex;
+#if (FILTER_FORM == 2)
+	pt_sample_t w = 36 * x, v;
+
+	v = (w >> 5) | ((w < 0) ? LP_SIGN_FILL : 0);
+	LP_y_new = LP_y_old = w;
+#else
+	pt_sample_t v = 0;
+
+	x = 0;
+#endif
+
+#if (PT_FUSED_BP == 1)
+	for (idex = 0; idex < BP_RING_SIZE; idex++) {
+		PT_dptr->BP_ring[idex].X = x;
+		PT_dptr->BP_ring[idex].V = v;
+	}
+#else
+	for (idex = 0; idex < LP_BUFFER_SIZE; idex++)
+		PT_dptr->LP_buf[idex] = x;
+	for (idex = 0; idex < HP_BUFFER_SIZE; idex++)
+		PT_dptr->HP_buf[idex] = v;
+#endif
+	y_h = 0;
+	for (idex = 0; idex < DR_BUFFER_SIZE; idex++)
+		PT_dptr->DR_buf[idex] = 0;
+	for (idex = 0; idex < MVA_BUFFER_SIZE; idex++)
+		PT_dptr->MVA_buf[idex] = 0;
+	MV_sum = 0;
+
+	Prev_val = Prev_Prev_val = 0;
+	Prev_valBP = Prev_Prev_valBP = 0;
+	Prev_valDR = Prev_Prev_valDR = 0;
+
+#ifdef PT_STAGE_RESET
+	PT_STAGE_RESET();
+#endif
+#if (PT_STAGE_OPS == 1)
+	if (STAGE_ops.Reset)
+		STAGE_ops.Reset();
+#endif
+
+	GAP_prime = 0;
+}
+#endif
+
+
+#if (PT_EDR == 1)
+/**********************************************************************************
+
+Fuction Name: EDRUpdate
+
+Parameter:
+Input	:	rr		- RR interval of the beat, 0 for the first beat after learning.
+			amp		- BP peak of the beat (Best_PeakBP or SB_peakBP).
+
+Returns	:	none	- Passes the resampled amplitude to EDRPoint.
+
+Description: Breathing moves the heart axis and changes the thoracic impedance, which
+modulates the QRS amplitude. The amplitude of each beat is linearly interpolated on a
+uniform grid of EDR_STEP samples (4 Hz) as in LFHFUpdate. The first beat after
+learning or a lost lead only starts the series.
+
+**********************************************************************************/
+void EDRUpdate(int16_t rr, pt_sample_t amp)
+{
+	if (!rr || !EDR_data.Prev_Amp) {
+		EDR_data.Prev_Amp = amp;
+		EDR_data.Phase = 0;
+		return;
+	}
+
+	// ---- Grid points between the previous and the current beat ---- //
+	while (EDR_data.Phase < rr) {
+		EDRPoint(EDR_data.Prev_Amp + (pt_sample_t) (((pt_acc_t) (amp - EDR_data.Prev_Amp) * EDR_data.Phase) / rr));
+		EDR_data.Phase += EDR_STEP;
+	}
+	EDR_data.Phase -= rr;
+	EDR_data.Prev_Amp = amp;
+}
+
+
+/**********************************************************************************
+
+Fuction Name: EDRPoint
+
+Parameter:
+Input	:	amp		- Resampled QRS amplitude.
+
+Returns	:	none	- Queues the EDR point and updates the respiratory rate.
+
+Description: The EDR is the amplitude minus its baseline (mean over 2^EDR_BASE_SHIFT
+points). Breaths are counted on upward zero crossings with a hysteresis of a quarter
+of the mean |EDR|, so beat-to-beat jitter does not count. The rate is 240 points per
+minute over the mean period of the last EDR_BREATHS breaths between EDR_MIN_PERIOD
+and EDR_MAX_PERIOD. Without a breath for twice EDR_MAX_PERIOD the rate is unknown (0).
+
+**********************************************************************************/
+void EDRPoint(pt_sample_t amp)
+{
+	pt_sample_t edr, a;
+	int16_t k;
+	int32_t sum = 0;
+
+	// ---- Baseline, primed with the first point ---- //
+	if (!EDR_data.Base)
+		EDR_data.Base = (pt_acc_t) amp << EDR_BASE_SHIFT;
+	EDR_data.Base += amp - (EDR_data.Base >> EDR_BASE_SHIFT);
+	edr = amp - (pt_sample_t) (EDR_data.Base >> EDR_BASE_SHIFT);
+
+	if (EDR_data.Count == EDR_QUEUE_SIZE) {
+		EDR_data.Head = (EDR_data.Head + 1) & (EDR_QUEUE_SIZE - 1);
+		--EDR_data.Count;
+		++EDR_data.Lost;
+	}
+	EDR_data.Queue[(EDR_data.Head + EDR_data.Count++) & (EDR_QUEUE_SIZE - 1)] = edr;
+
+	// ---- Zero crossings with hysteresis ---- //
+	a = (edr < 0) ? -edr : edr;
+	EDR_data.Env += (a - EDR_data.Env) >> 3;
+	if (EDR_data.Since < INT16_MAX)
+		++EDR_data.Since;
+
+	if (edr > (EDR_data.Env >> 2) && EDR_data.Sign < 0) {
+		if (EDR_data.Since >= EDR_MIN_PERIOD && EDR_data.Since <= EDR_MAX_PERIOD) {
+			EDR_data.Period[EDR_data.Period_p] = EDR_data.Since;
+			if (++EDR_data.Period_p == EDR_BREATHS)
+				EDR_data.Period_p = 0;
+			if (EDR_data.N < EDR_BREATHS)
+				++EDR_data.N;
+		}
+		EDR_data.Sign = 1;
+		EDR_data.Since = 0;
+	}
+	else if (edr < -(EDR_data.Env >> 2))
+		EDR_data.Sign = -1;
+
+	// ---- Rate over the last breaths ---- //
+	if (EDR_data.Since > 2 * EDR_MAX_PERIOD)
+		EDR_data.N = 0;
+	if (EDR_data.N < EDR_BREATHS) {
+		EDR_data.Rate = 0;
+		return;
+	}
+	for (k = 0; k < EDR_BREATHS; k++)
+		sum += EDR_data.Period[k];
+	EDR_data.Rate = (uint16_t) ((((int32_t) 60 * (PT_FS / EDR_STEP) * EDR_BREATHS) << RESP_Q) / sum);
+}
+#endif
+
+
+#if (PT_MULTILEAD == 1)
+/**********************************************************************************
+
+Fuction Name: PT_StateMachineLeads
+
+Parameter:
+Input	:	datum		- Most recent sample of each of the PT_LEADS leads.
+
+Returns	:	BeatDelay	- If non-zero a qrs has been detected with BeatDelay samples.
+
+Description: Multi-lead version of PT_StateMachine giving one beat stream for all
+leads. Every lead runs the BP, derivative and squaring steps of PT_StateMachine
+(LPStep, HPStep, DerivStep and SQRStep, so one lead gives the same beats and the
+same PT_CLIP_STATS counts, summed over the leads). The filter states
+are stored lead-innermost, each filter step is one loop over the leads that the
+compiler can vectorise. The leads are fused before the integration: the squared
+signals, and |BP| and |derivative| for the BP thresholds and the T-wave test, are
+averaged with the weights of LeadWeights. A single MVAFilter, peak detector and
+BeatDecision follow, so the thresholds learn from the fused signal. Leads failing
+the quality test of LeadQuality drop out of the average. PT_SQI, PT_AGC,
+PT_PREPROC, PT_R_REFINE and the user stages only apply to PT_StateMachine. Do not
+mix both on one record.
+
+**********************************************************************************/
+int16_t PT_StateMachineLeads(const pt_sample_t *datum)
+{
+	struct PT_lead_bank *bank = &ML_bank;
+	int16_t l, i = bank->Pointer;
+	pt_sample_t v, y, d, a;
+	pt_acc_t bp_sum = 0, dr_sum = 0, sq_sum = 0;
+
+	++Sample_Clock;
+
+	for (l = 0; l < PT_LEADS; l++) {
+		// ---- LowPass and HighPass, see BPFilter ---- //
+		v = LPStep(&bank->LP_y_old[l], &bank->LP_y_new[l], datum[l], bank->X[(i - 6) & (BP_RING_SIZE - 1)][l], bank->X[(i - 12) & (BP_RING_SIZE - 1)][l]);
+		y = HPStep(&bank->Y_h[l], v, bank->V[(i - 16) & (BP_RING_SIZE - 1)][l], bank->V[(i - 17) & (BP_RING_SIZE - 1)][l], bank->V[i][l]);
+		bank->X[i][l] = datum[l];
+		bank->V[i][l] = v;
+
+		// ---- Derivative, see DerivFilter ---- //
+		d = DerivStep((pt_sample_t *) bank->DR_buf + l, PT_LEADS, y);
+
+		// ---- Lead quality, see SQIUpdate ---- //
+		if (datum[l] < bank->Min[l]) bank->Min[l] = datum[l];
+		if (datum[l] > bank->Max[l]) bank->Max[l] = datum[l];
+		bank->Rail_Cnt[l] += (datum[l] >= SQI_RAIL_HIGH || datum[l] <= SQI_RAIL_LOW);
+
+		// ---- Squaring, see SQRFilter, and the weighted sums ---- //
+		a = (y < 0) ? -y : y;
+		bank->Sum_HP[l] += a;
+		bp_sum += (pt_acc_t) bank->Fuse_w[l] * a;
+
+		a = (d < 0) ? -d : d;
+		bank->Sum_DR[l] += a;
+		dr_sum += (pt_acc_t) bank->Fuse_w[l] * a;
+		sq_sum += (pt_acc_t) bank->Fuse_w[l] * SQRStep(d);
+	}
+	bank->Pointer = (i + 1) & (BP_RING_SIZE - 1);
+
+	// ---- Fused signals, the weights sum to 256 ---- //
+	PT_dptr->HPF_val = (pt_sample_t) (bp_sum >> 8);
+	PT_dptr->DRF_val = (pt_sample_t) (dr_sum >> 8);
+	PT_dptr->SQF_val = (pt_level_t) (sq_sum >> 8);
+
+	PeakDtcBP(PT_dptr->HPF_val);
+	PeakDtcDR(PT_dptr->DRF_val);
+	MVAFilter();
+
+	if (++bank->Cnt == PT1000MS)
+		LeadQuality();
+
+	return (BeatDecision(PeakDtcI()));
+}
+
+
+/**********************************************************************************
+
+Fuction Name: LeadQuality
+
+Parameter:
+Input	:	none	- Block statistics of ML_bank.
+
+Returns	:	none	- Updates the usable leads and the fusion weights.
+
+Description: Same tests as SQIUpdate on each lead once per PT1000MS: flat, half the
+block at the rails or a derivative to BP ratio above SQI_NOISE_LIM makes the lead
+unusable, SQI_GOOD_BLOCKS good blocks make it usable again.
+
+**********************************************************************************/
+void LeadQuality(void)
+{
+	struct PT_lead_bank *bank = &ML_bank;
+	int16_t l, good;
+	uint16_t noise;
+
+	for (l = 0; l < PT_LEADS; l++) {
+		noise = bank->Sum_HP[l] ? (uint16_t) (((uint64_t) bank->Sum_DR[l] << 8) / (uint64_t) bank->Sum_HP[l]) : 0;
+		good = bank->Rail_Cnt[l] < (PT1000MS >> 1) && bank->Max[l] - bank->Min[l] > SQI_FLAT_RANGE && noise <= SQI_NOISE_LIM;
+
+		if (!good) {
+			bank->Usable[l] = 0;
+			bank->Good_Blocks[l] = 0;
+		}
+		else if (!bank->Usable[l] && ++bank->Good_Blocks[l] >= SQI_GOOD_BLOCKS)
+			bank->Usable[l] = 1;
+
+		bank->Sum_HP[l] = bank->Sum_DR[l] = 0;
+		bank->Min[l] = SQI_RAIL_HIGH;
+		bank->Max[l] = SQI_RAIL_LOW;
+		bank->Rail_Cnt[l] = 0;
+	}
+	bank->Cnt = 0;
+
+	LeadWeights();
+}
+
+
+/**********************************************************************************
+
+Fuction Name: LeadWeights
+
+Parameter:
+Input	:	none	- ML_weight and the usable leads.
+
+Returns	:	none	- Updates ML_bank.Fuse_w.
+
+Description: Scales the weights of the usable leads to a sum of 256 so the fused
+signals stay in the range of a single lead. All zero if no lead is usable.
+
+**********************************************************************************/
+void LeadWeights(void)
+{
+	int16_t l;
+	int32_t sum = 0;
+
+	for (l = 0; l < PT_LEADS; l++)
+		sum += ML_bank.Usable[l] ? ML_weight[l] : 0;
+
+	for (l = 0; l < PT_LEADS; l++)
+		ML_bank.Fuse_w[l] = (sum && ML_bank.Usable[l]) ? (int16_t) (((int32_t) ML_weight[l] << 8) / sum) : 0;
+}
+#endif
+
+
+#if (PT_QRS_WIDTH == 1)
+/**********************************************************************************
+
+Fuction Name: QRSEdge
+
+Parameter:
+Input	:	PEAKI	- Peak of the integrated signal found on this sample, 0 if none.
+
+Returns	:	none	- Updates QRS_data, the edge of the peak in On/Off[QRS_PEAK].
+
+Description: The integrated signal rises while the QRS enters the MVA window, so
+its rising edge spans the QRS when the window is wider than the QRS. The edge
+starts after the last falling sample. Within the edge the onset and offset are the
+first and last samples where |DRF_val| exceeds the previous QRS slope (Old_PeakDR,
+or the slope so far for the first beat) shifted by QRS_SLOPE_SHIFT. The filters
+spread the QRS over more than the MVA window, so without the slope test the edge
+would only measure the window. PeakDtcI reports the peak one
+sample late, the edge is read before this sample can restart it. The blanking and
+search-back of BeatDecision carry the edge of the peak they hold (QRS_COPY).
+
+**********************************************************************************/
+void QRSEdge(pt_level_t PEAKI)
+{
+	pt_sample_t dr = (PT_dptr->DRF_val < 0) ? -PT_dptr->DRF_val : PT_dptr->DRF_val;
+
+	// ---- Edge of the peak, which is the previous sample ---- //
+	if (PEAKI) {
+		QRS_data.On[QRS_PEAK] = QRS_data.Slope_First ? QRS_data.Slope_First : QRS_data.Edge_Start;
+		QRS_data.Off[QRS_PEAK] = QRS_data.Slope_First ? QRS_data.Slope_Last : Sample_Clock - 1;
+	}
+
+	if (PT_dptr->MVA_val < QRS_data.Prev_MVA) {
+		QRS_data.Edge_Start = Sample_Clock + 1;
+		QRS_data.Slope_First = 0;
+	}
+	else if (dr > ((Old_PeakDR ? Old_PeakDR : Best_PeakDR) >> QRS_SLOPE_SHIFT)) {
+		if (!QRS_data.Slope_First)
+			QRS_data.Slope_First = Sample_Clock;
+		QRS_data.Slope_Last = Sample_Clock;
+	}
+	QRS_data.Prev_MVA = PT_dptr->MVA_val;
+}
+
+
+/**********************************************************************************
+
+Fuction Name: QRSEmit
+
+Parameter:
+Input	:	src		- QRS_HELD for a beat, QRS_SB for a search-back beat.
+
+Returns	:	none	- Updates QRS_data.Onset, Offset and Width.
+
+Description: Converts the edge of the beat to delays to the current sample, like the
+BeatDelay of PT_StateMachine. The edge is on the derivative time scale, which is
+PT_DELAY - MVA_DELAY behind the input.
+
+**********************************************************************************/
+void QRSEmit(int16_t src)
+{
+	QRS_data.Onset = (int16_t) (Sample_Clock - QRS_data.On[src]) + PT_DELAY - MVA_DELAY;
+	QRS_data.Offset = (int16_t) (Sample_Clock - QRS_data.Off[src]) + PT_DELAY - MVA_DELAY;
+	QRS_data.Width = (int16_t) (QRS_data.Off[src] - QRS_data.On[src]) + 1;
+}
+#endif
+
+
+#if (PT_SNAPSHOT == 1)
+/**********************************************************************************
+
+Fuction Name: PT_Snapshot
+
+Parameter:
+Input	:	buf		- Receives the snapshot, PT_get_SnapshotSize_output() bytes.
+
+Returns	:	Bytes written to buf.
+
+Description: Saves the whole detector state (filters, thresholds, RR averages, the
+optional modules and their settings kept over PT_init) after the last sample, so
+PT_Restore resumes exactly where the snapshot was taken. The state is copied as it
+is in memory: a snapshot is only valid for the same build (checked with SNAP_CONFIG
+and the size). The user stages of PT_STAGE_OPS and PT_STAGE_HEADER are not saved.
+
+**********************************************************************************/
+uint32_t PT_Snapshot(void *buf)
+{
+	struct PT_snap_head head;
+
+	head.Magic = SNAP_MAGIC;
+	head.Config = SNAP_CONFIG;
+	head.Size = PT_get_SnapshotSize_output();
+	head.Clock = Sample_Clock;
+	memcpy(buf, &head, sizeof(head));
+	SnapCopy((uint8_t *) buf + sizeof(head), 1);
+
+	return (head.Size);
+}
+
+
+/**********************************************************************************
+
+Fuction Name: PT_Restore
+
+Parameter:
+Input	:	buf		- Snapshot written by PT_Snapshot.
 
-/**********************************************************************************
-
-Fuction Name: UpdateThI
+Returns	:	0 if restored, -1 if buf is not a snapshot of this build (state unchanged).
+
+Description: Replaces the detector state with the snapshot, the next sample fed to
+PT_StateMachine is the one following the snapshot (PT_get_SampleClock_output()).
+
+**********************************************************************************/
+int16_t PT_Restore(const void *buf)
+{
+	struct PT_snap_head head;
+
+	memcpy(&head, buf, sizeof(head));
+	if (head.Magic != SNAP_MAGIC || head.Config != SNAP_CONFIG || head.Size != PT_get_SnapshotSize_output())
+		return (-1);
+	SnapCopy((uint8_t *) buf + sizeof(head), 0);
+
+	return (0);
+}
+
+
+/**********************************************************************************
+
+Fuction Name: PT_Seek
 
 Parameter:
-Input	:	PEAKI	- Pointer to the overal peak
-			NOISE_F	- flag that indicates whether the peak is noise or not.
+Input	:	snaps	- count snapshots of PT_get_SnapshotSize_output() bytes each, in
+					  ascending Sample_Clock, e.g. taken every few minutes of a first pass.
+			count	- Number of snapshots.
+			clock	- Sample to seek to, in Sample_Clock.
 
-Returns	:	none	- Recieves PEAKI and updates Signal peak estimate (SPKI), Noise peak
-peak estimate (NPKI)
+Returns	:	Index of the restored snapshot, -1 if none is at or before clock or if they
+			are not snapshots of this build.
 
-Description: This function recursively updates the adaptive noise and signal thresholds in
-the Integrated signal. Implements Eq 12-16.
+Description: Restores the latest snapshot at or before clock (binary search). The
+samples from PT_get_SampleClock_output() to clock are then either replayed, which
+gives exactly the beats of the first pass, or skipped with PT_Gap (PT_GAP), which
+only costs the GAP_WARMUP samples after clock without decisions.
 
 **********************************************************************************/
-void UpdateThI( uint16_t *PEAKI, int8_t NOISE_F)
+int32_t PT_Seek(const void *snaps, int32_t count, uint32_t clock)
 {
-	// ------ Update Noise & Signal Estimate ------ //
-	if (NOISE_F) {
-		PT_dptr->NPKI -= PT_dptr->NPKI >> 3;
-		PT_dptr->NPKI += *PEAKI >> 3;
-	}
-	else {
-		PT_dptr->SPKI -= PT_dptr->SPKI >> 3;
-		PT_dptr->SPKI += *PEAKI >> 3;
+	struct PT_snap_head head;
+	uint32_t snap_size = PT_get_SnapshotSize_output();
+	int32_t lo = 0, hi = count - 1, mid, found = -1;
+
+	// ---- Latest snapshot with Clock <= clock ---- //
+	while (lo <= hi) {
+		mid = lo + ((hi - lo) >> 1);
+		memcpy(&head, (const uint8_t *) snaps + (size_t) mid * snap_size, sizeof(head));
+		if (head.Clock <= clock) {
+			found = mid;
+			lo = mid + 1;
+		}
+		else
+			hi = mid - 1;
 	}
 
-	// --------- Update Thresholds ---------------- //
-	PT_dptr->ThI1 = PT_dptr->NPKI + ((PT_dptr->SPKI - PT_dptr->NPKI) >> 2);
-	PT_dptr->ThI2 = PT_dptr->ThI1 >> 1;
+	if (found < 0 || PT_Restore((const uint8_t *) snaps + (size_t) found * snap_size) != 0)
+		return (-1);
+
+	return (found);
 }
 
 
 /**********************************************************************************
 
-Fuction Name: UpdateThF
+Fuction Name: SnapCopy
 
 Parameter:
-Input	:	PEAKF	- Pointer to the overal peak
-			NOISE_F	- Flag that indicates whether the peak is noise or not.
+Input	:	buf		- State part of a snapshot, NULL to only count the bytes.
+			save	- 1 copies the state to buf, 0 copies buf to the state.
 
-Returns	:	none	- Recieves PEAKF and updates Signal peak estimate in BP signal(SPKF), Noise peak
-peak estimate (NPKF)
+Returns	:	Bytes of the state.
 
-Description: This function recursively updates the adaptive noise and signal thresholds in 
-the BP signal. Implements Eq 17-21.
+Description: The single list of the state variables, so PT_Snapshot, PT_Restore and
+the snapshot size always agree. A variable added to the detector goes here too.
 
 **********************************************************************************/
-void UpdateThF(int16_t *PEAKF, int8_t NOISE_F)
+uint32_t SnapCopy(uint8_t *buf, int16_t save)
 {
-	// ------ Update Noise & Signal Estimate ------ //
-	if (NOISE_F) {
-		PT_dptr->NPKF -= PT_dptr->NPKF >> 3;
-		PT_dptr->NPKF += *PEAKF >> 3;
+	uint32_t size = 0;
+
+	SNAP(PT_data);
+	SNAP(Count_SinceRR); SNAP(RR1_p); SNAP(RR2_p); SNAP(RR1_sum); SNAP(RR2_sum);
+	SNAP(BlankTimeCnt); SNAP(SBcntI);
+	SNAP(Prev_valBP); SNAP(Prev_Prev_valBP); SNAP(Best_PeakBP); SNAP(Prev_valDR);
+	SNAP(Prev_Prev_valDR); SNAP(Best_PeakDR); SNAP(Old_PeakDR); SNAP(SB_peakBP);
+	SNAP(SB_peakDR); SNAP(y_h); SNAP(st_mean_pkBP);
+	SNAP(MV_sum); SNAP(PEAKI_temp); SNAP(st_mx_pk); SNAP(st_mean_pk);
+	SNAP(Prev_val); SNAP(Prev_Prev_val); SNAP(SB_peakI);
+	SNAP(Sample_Clock);
+#if (FILTER_FORM == 2)
+	SNAP(LP_y_new); SNAP(LP_y_old);
+#endif
+#if (PT_LOW_LATENCY == 1)
+	SNAP(Beat_Event); SNAP(Prov_Pending); SNAP(Prov_Delay); SNAP(Prov_Lost);
+#endif
+#if (PT_HRV == 1)
+	SNAP(HRV_data);
+#endif
+#if (PT_LFHF == 1)
+	SNAP(LFHF_data); SNAP(LFHF_last);
+#endif
+#if (PT_HRSTAT == 1)
+	SNAP(HRSTAT_data);
+#endif
+#if (PT_TREND == 1)
+	SNAP(TREND_data);
+#endif
+#if (PT_ALARM == 1)
+	SNAP(ALARM_data); SNAP(ALARM_config);
+#endif
+#if (PT_SQI == 1)
+	SNAP(SQI_data);
+#endif
+#if (PT_AGC == 1)
+	SNAP(AGC_data);
+#endif
+#if (PT_PREPROC == 1)
+	SNAP(PRE_data); SNAP(PRE_mode); SNAP(PRE_delay);
+#endif
+#if (PT_R_REFINE == 1)
+	SNAP(RPK_data);
+#endif
+#if (PT_TEMPLATE == 1)
+	SNAP(TPL_data);
+#endif
+#if (PT_EDR == 1)
+	SNAP(EDR_data);
+#endif
+#if (PT_MULTILEAD == 1)
+	SNAP(ML_bank); SNAP(ML_weight); SNAP(ML_weight_set);
+#endif
+#if (PT_QRS_WIDTH == 1)
+	SNAP(QRS_data);
+#endif
+#if (PT_GAP == 1)
+	SNAP(GAP_prime); SNAP(GAP_warm);
+#endif
+#if (PT_CLIP_STATS == 1)
+	SNAP(CLIP_data);
+#endif
+
+	return (size);
+}
+#endif
+
+
+#if (PT_OFFLINE == 1)
+/**********************************************************************************
+
+Fuction Name: PT_Offline
+
+Parameter:
+Input	:	x			- ECG record, n samples.
+			n			- Number of samples.
+			work		- Buffer of n samples, holds the zero-phase BP signal on return.
+			peaks		- Receives the sample index (in x) of each R peak.
+			max_peaks	- Size of peaks.
+
+Returns	:	Number of R peaks written to peaks.
+
+Description: Non-causal processing of a whole record (archives, Holter). The record
+is bandpass filtered forward and then backward with the streaming filters (STAGE_BANDPASS),
+so the BP signal has no phase shift and no delay. Thresholds are learnt from the
+first OFFLINE_LEARN samples ahead (OfflineLearn) instead of LearningPhase1, so beats
+are detected from the start of the record, and again after an emergency reset. The
+derivative, squaring, integration and BeatDecision are the streaming ones. Each beat
+is aligned on the largest |BP| within OFFLINE_R_WIN samples. Calls PT_init, the
+streaming state is lost. PT_PREPROC, PT_AGC and PT_SQI are not applied.
+
+**********************************************************************************/
+int32_t PT_Offline(const pt_sample_t *x, int32_t n, pt_sample_t *work, int32_t *peaks, int32_t max_peaks)
+{
+	int32_t i, j, loc, end, count = 0;
+	int16_t BeatDelay, state;
+	pt_sample_t datum, a, best;
+
+	PT_init();
+
+	// ---- Zero-phase bandpass, forward then backward in place ---- //
+	for (i = 0; i < n; i++) {
+		datum = x[i];
+		STAGE_BANDPASS(datum);
+		work[i] = PT_dptr->HPF_val;
 	}
-	else {
-		PT_dptr->SPKF -= PT_dptr->SPKF >> 3;
-		PT_dptr->SPKF += *PEAKF >> 3;
+	ResetDetector();
+	for (i = n - 1; i >= 0; i--) {
+		datum = work[i];
+		STAGE_BANDPASS(datum);
+		work[i] = PT_dptr->HPF_val;
 	}
 
-	// --------- Update Thresholds ---------------- //
-	PT_dptr->ThF1 = PT_dptr->NPKF + ((PT_dptr->SPKF - PT_dptr->NPKF) >> 2);
-	PT_dptr->ThF2 = PT_dptr->ThF1 >> 1;
+	OfflineLearn(work, n);
+
+	for (i = 0; i < n && count < max_peaks; i++) {
+		++Sample_Clock;
+		PT_dptr->HPF_val = work[i];
+		PeakDtcBP(PT_dptr->HPF_val);
+		STAGE_DERIV();
+		PeakDtcDR(PT_dptr->DRF_val);
+		STAGE_SQUARE();
+		STAGE_INTEGRATE();
+
+		state = PT_dptr->PT_state;
+		BeatDelay = BeatDecision(PeakDtcI());
+
+		// ---- Emergency reset, learn the thresholds ahead again ---- //
+		if (PT_dptr->PT_state == START_UP && state != START_UP)
+			OfflineLearn(work + i + 1, n - i - 1);
+
+		if (!BeatDelay)
+			continue;
+
+		// ---- The BP filters have no delay offline, align on the R peak ---- //
+		loc = i - BeatDelay + OFFLINE_SHIFT;
+		j = (loc > OFFLINE_R_WIN) ? loc - OFFLINE_R_WIN : 0;
+		end = (loc + OFFLINE_R_WIN < n) ? loc + OFFLINE_R_WIN : n - 1;
+		for (best = -1; j <= end; j++) {
+			a = (work[j] < 0) ? -work[j] : work[j];
+			if (a > best) {
+				best = a;
+				loc = j;
+			}
+		}
+		peaks[count++] = loc;
+	}
+
+	return (count);
 }
 
 
+/**********************************************************************************
+
+Fuction Name: OfflineLearn
+
+Parameter:
+Input	:	bp		- Zero-phase BP signal from the current sample on.
+			n		- Samples left in bp.
+
+Returns	:	none	- Sets the thresholds and the state to LEARN_PH_2.
+
+Description: Replaces LearningPhase1 offline. Runs the derivative, squaring and
+integration over the next OFFLINE_LEARN samples (or what is left of the record) and
+takes the signal estimates from the mean of the largest peak of each second and the
+noise estimates from the mean of all peaks, with the same scaling as LearningPhase1.
+The filters are cleared again before detection starts. If no peak is found the state
+stays START_UP and LearningPhase1 takes over.
+
+**********************************************************************************/
+void OfflineLearn(const pt_sample_t *bp, int32_t n)
+{
+	int32_t j, n_pk = 0, n_sec = 0;
+	uint64_t sum_pk = 0, sum_mx = 0;
+	int64_t sum_pkBP = 0, sum_mxBP = 0;
+	pt_level_t p, sec_mx = 0;
+	pt_sample_t sec_mxBP = 0;
+
+	if (n > OFFLINE_LEARN)
+		n = OFFLINE_LEARN;
+
+	ResetDetector();
+	for (j = 0; j < n; j++) {
+		PT_dptr->HPF_val = bp[j];
+		PeakDtcBP(PT_dptr->HPF_val);
+		STAGE_DERIV();
+		PeakDtcDR(PT_dptr->DRF_val);
+		STAGE_SQUARE();
+		STAGE_INTEGRATE();
+
+		if ((p = PeakDtcI()) != 0) {
+			sum_pk += p;
+			sum_pkBP += Best_PeakBP;
+			++n_pk;
+			if (p > sec_mx) sec_mx = p;
+			if (Best_PeakBP > sec_mxBP) sec_mxBP = Best_PeakBP;
+			Best_PeakBP = 0;
+		}
+
+		// ---- Largest peaks of each second ---- //
+		if ((j % PT1000MS) == PT1000MS - 1 || j == n - 1) {
+			if (sec_mx) {
+				sum_mx += sec_mx;
+				sum_mxBP += sec_mxBP;
+				++n_sec;
+			}
+			sec_mx = 0;
+			sec_mxBP = 0;
+		}
+	}
+
+	ResetDetector();
+	if (!n_pk)
+		return;
+
+	PT_dptr->PT_state = LEARN_PH_2;
+
+	// ---- Integrated Signal Thresholds ------- //
+	PT_dptr->SPKI = (pt_level_t) ((sum_mx / n_sec) >> 1);
+	PT_dptr->NPKI = (pt_level_t) ((sum_pk / n_pk) >> 3);
+	PT_dptr->ThI1 = PT_dptr->NPKI + ((pt_acc_t) (PT_dptr->SPKI - PT_dptr->NPKI) >> 2);
+	PT_dptr->ThI2 = PT_dptr->ThI1 >> 1;
+
+	// -------- BP Signal Thresholds ---------- //
+	PT_dptr->SPKF = (pt_sample_t) ((sum_mxBP / n_sec) >> 1);
+	PT_dptr->NPKF = (pt_sample_t) ((sum_pkBP / n_pk) >> 3);
+	PT_dptr->ThF1 = PT_dptr->NPKF + ((PT_dptr->SPKF - PT_dptr->NPKF) >> 2);
+	PT_dptr->ThF2 = PT_dptr->ThF1 >> 1;
+}
+#endif
 
 /**************************************************
 Helper functions for debugging and easy management.
@@ -859,82 +3323,526 @@ int16_t PT_get_State_output(void) {
 
 
 // ------Returns LP filter value ------ //
-int16_t PT_get_LPFilter_output(void) {
+pt_sample_t PT_get_LPFilter_output(void) {
 	return (PT_dptr->LPF_val);
 }
 
 // ------Returns HP filter value ------ //
-int16_t PT_get_HPFilter_output(void) {
+pt_sample_t PT_get_HPFilter_output(void) {
 	return (PT_dptr->HPF_val);
 }
 
 // ------Returns Dr filter value ------ //
-int16_t PT_get_DRFilter_output(void) {
+pt_sample_t PT_get_DRFilter_output(void) {
 	return (PT_dptr->DRF_val);
 }
 
 // ------Returns MVA filter value ------ //
-uint16_t PT_get_MVFilter_output(void) {
+pt_level_t PT_get_MVFilter_output(void) {
 	return (PT_dptr->MVA_val);
 }
 
 // ------Returns SQR filter value ------ //
-uint16_t PT_get_SQRFilter_output(void) {
+pt_level_t PT_get_SQRFilter_output(void) {
 	return (PT_dptr->SQF_val);
 }
 
 
 
 /************************************
-Returns instantanous heart rate per minute.
+Returns instantanous heart rate per minute (rounded).
 
 Input - Fs : Sampling Frequency of the signal
 *************************************/
 int16_t PT_get_ShortTimeHR_output(int16_t Fs) {
-	return (60 / (PT_dptr->Recent_RR_M / Fs));
+	if (Fs == PT_FS)
+		return ((PT_get_ShortTimeHRQ_output() + (1 << (HR_Q - 1))) >> HR_Q);
+	return (((int32_t) 60 * Fs + (PT_dptr->Recent_RR_M >> 1)) / PT_dptr->Recent_RR_M);
 }
 
 /************************************
-Returns robust heart rate per minute
+Returns robust heart rate per minute (rounded).
 
 Input - Fs : Sampling Frequency of the signal
 *************************************/
 int16_t PT_get_LongTimeHR_output(int16_t Fs) {
-	return (60 / (PT_dptr->RR_M / Fs));
+	if (Fs == PT_FS)
+		return ((PT_get_LongTimeHRQ_output() + (1 << (HR_Q - 1))) >> HR_Q);
+	return (((int32_t) 60 * Fs + (PT_dptr->RR_M >> 1)) / PT_dptr->RR_M);
+}
+
+/************************************
+Returns the heart rate per minute in Q(HR_Q) of an RR interval
+given in samples at PT_FS. Uses the reciprocal table, no division.
+
+Input - rr : RR interval in samples
+*************************************/
+uint16_t PT_RR_to_HR(int16_t rr) {
+	if (rr < HR_RR_MIN)
+		rr = HR_RR_MIN;
+	else if (rr >= HR_RR_MIN + HR_TABLE_SIZE)
+		rr = HR_RR_MIN + HR_TABLE_SIZE - 1;
+	return (HR_table[rr - HR_RR_MIN]);
+}
+
+// ------Returns instantanous heart rate per minute in Q(HR_Q) ------ //
+uint16_t PT_get_ShortTimeHRQ_output(void) {
+	return (PT_RR_to_HR(PT_dptr->Recent_RR_M));
+}
+
+// ------Returns robust heart rate per minute in Q(HR_Q) ------ //
+uint16_t PT_get_LongTimeHRQ_output(void) {
+	return (PT_RR_to_HR(PT_dptr->RR_M));
+}
+
+// ------Returns the delay of the filter pipeline, GENERAL_DELAY plus the preprocessing stages ------ //
+int16_t PT_get_Delay_output(void) {
+	return (PT_DELAY);
 }
 
 
 // ------Returns the main threshold integrated signal Th value ------ //
-uint16_t PT_get_ThI1_output(void) {
+pt_level_t PT_get_ThI1_output(void) {
 	return (PT_dptr->ThI1);
 }
 
 // ------Returns the main threshold BP signal Th value ------ //
-int16_t PT_get_ThF1_output(void) {
+pt_sample_t PT_get_ThF1_output(void) {
 	return (PT_dptr->ThF1);
 }
 
 // ------Returns Signal Level Estimate in Integrated Signal ----- //
-uint16_t PT_get_SKPI_output(void) {
+pt_level_t PT_get_SKPI_output(void) {
 	return (PT_dptr->SPKI);
 }
 
 // ------Returns Noise Level Estimate in Integrated Signal ------ //
-uint16_t PT_get_NPKI_output(void) {
+pt_level_t PT_get_NPKI_output(void) {
 	return (PT_dptr->NPKI);
 }
 
 // ------Returns Signal Level Estimate in BP Signal ------ //
-int16_t PT_get_SPKF_output(void) {
+pt_sample_t PT_get_SPKF_output(void) {
 	return (PT_dptr->SPKF);
 }
 
 // ------Returns Noise Level Estimate in BP Signal ------ //
-int16_t PT_get_NPKF_output(void) {
+pt_sample_t PT_get_NPKF_output(void) {
 	return (PT_dptr->NPKF);
 }
 
 // ------Returns HR state -> Regular:0, Irregular:1 ------ //
 int16_t PT_get_HRState_output(void) {
 	return (PT_dptr->HR_State);
-}
\ No newline at end of file
+}
+
+// ------Returns the number of samples processed since PT_init ------ //
+uint32_t PT_get_SampleClock_output(void) {
+	return (Sample_Clock);
+}
+
+#if (PT_HRV == 1)
+/************************************
+Returns the HRV statistics of the sliding window, the last
+PT_HRV_WINDOW samples. Beats is zero until the window has been
+covered once.
+
+Input - stats : Pointer to the statistics
+*************************************/
+void PT_get_HRV_output(struct PT_hrv_stats *stats) {
+	if (HRV_data.Full)
+		HRVStats(&HRV_data, stats);
+	else
+		memset(stats, 0, sizeof(*stats));
+}
+
+/************************************
+Returns the HRV statistics of the sliding window, also before
+it has been covered once.
+
+Input - stats : Pointer to the statistics
+*************************************/
+void PT_get_RunningHRV_output(struct PT_hrv_stats *stats) {
+	HRVStats(&HRV_data, stats);
+}
+#endif
+
+#if (PT_LFHF == 1)
+/************************************
+Returns LF and HF power of the last complete block of LFHF_N
+resampled points (64 sec), zero until the first block is complete.
+
+Input - stats : Pointer to the statistics
+*************************************/
+void PT_get_LFHF_output(struct PT_lfhf_stats *stats) {
+	*stats = LFHF_last;
+}
+#endif
+
+#if (PT_HRSTAT == 1)
+/************************************
+Returns minimum, maximum and median heart rate (bpm) of a
+window, beats older than the window are removed first.
+All zero for another win.
+
+Input - win : 0, 1 or 2 for the last 1, 5 or 60 minutes
+		stats : Pointer to the statistics
+*************************************/
+void PT_get_HRStats_output(int16_t win, struct PT_hrstat_stats *stats) {
+	struct PT_hrstat_win *w;
+
+	memset(stats, 0, sizeof(*stats));
+	if (win < 0 || win >= HRSTAT_WINDOWS)
+		return;
+
+	w = &HRSTAT_data.Win[win];
+	HRStatExpire(w, HRSTAT_win_len[win]);
+	stats->Beats = w->Count;
+	stats->Min = w->Count ? HRSTAT_data.HR[w->Min_q[w->Min_h] & (PT_HRSTAT_BUFFER_SIZE - 1)] : 0;
+	stats->Max = w->Count ? HRSTAT_data.HR[w->Max_q[w->Max_h] & (PT_HRSTAT_BUFFER_SIZE - 1)] : 0;
+	stats->Median = PT_get_HRPercentile_output(win, 50);
+}
+
+/************************************
+Returns a percentile of the heart rate (bpm) of a window from
+its histogram, 0 if the window holds no beat or win is not
+a window.
+
+Input - win : 0, 1 or 2 for the last 1, 5 or 60 minutes
+		pct : Percentile, 0 - 100 (clamped)
+*************************************/
+uint16_t PT_get_HRPercentile_output(int16_t win, int16_t pct) {
+	struct PT_hrstat_win *w;
+	int32_t rank;
+	uint16_t hr;
+
+	if (win < 0 || win >= HRSTAT_WINDOWS)
+		return (0);
+	pct = (pct < 0) ? 0 : ((pct > 100) ? 100 : pct);
+
+	w = &HRSTAT_data.Win[win];
+	HRStatExpire(w, HRSTAT_win_len[win]);
+	if (!w->Count)
+		return (0);
+
+	rank = ((int32_t) (w->Count - 1) * pct) / 100;
+	for (hr = 0; hr < HRSTAT_BINS - 1; hr++) {
+		rank -= w->Hist[hr];
+		if (rank < 0) break;
+	}
+	return (hr);
+}
+#endif
+
+#if (PT_TREND == 1)
+/************************************
+Returns a closed trend bucket, 1 if the bucket is still stored,
+0 if not or level is not a level.
+
+Input - level : 0, 1, 2 or 3 for buckets of 10 sec, 1 min, 10 min or 1 hour
+		age : 0 for the most recent closed bucket of the level
+		summary : Pointer to the summary
+*************************************/
+int16_t PT_get_TrendBucket_output(int16_t level, uint16_t age, struct PT_trend_summary *summary) {
+	const struct PT_trend_bucket *b;
+
+	memset(summary, 0, sizeof(*summary));
+	if (level < 0 || level >= TREND_LEVELS)
+		return (0);
+
+	TrendAdvance();
+	if (age >= TREND_size[level] || age >= TREND_data.Closed[level])
+		return (0);
+
+	b = &TREND_data.Buf[TREND_offset[level] + (TREND_data.Closed[level] - 1 - age) % TREND_size[level]];
+	summary->Beats = b->Beats;
+	if (b->Beats) {
+		summary->Min = b->Min;
+		summary->Max = b->Max;
+		summary->Mean = (uint16_t) (b->Sum / b->Beats);
+	}
+	return (1);
+}
+
+/************************************
+Returns the heart-rate summary of the last seconds, limited to
+the stored trend. The range is covered from the most recent bucket
+backward, moving to the longest buckets that fit, so a query touches
+a few buckets per level. The start of the range is rounded to the
+shortest buckets still stored (10 sec for the last hour, 1 min for
+2 hours, 10 min for 24 hours and 1 hour beyond).
+
+Input - seconds : Length of the range
+		summary : Pointer to the summary
+*************************************/
+void PT_get_TrendSummary_output(uint32_t seconds, struct PT_trend_summary *summary) {
+	const struct PT_trend_bucket *bucket = &TREND_data.Cur[0];
+	uint64_t sum = 0;
+	uint32_t t, begin, b;
+	int16_t level = 0;
+
+	TrendAdvance();
+	memset(summary, 0, sizeof(*summary));
+	summary->Min = UINT16_MAX;
+	t = TREND_data.Start;
+	begin = (uint32_t) PT_FS * seconds;
+	begin = (begin < Sample_Clock) ? Sample_Clock - begin : 0;
+
+	for (;;) {
+		if (bucket->Beats) {
+			sum += bucket->Sum;
+			summary->Beats += bucket->Beats;
+			if (bucket->Min < summary->Min) summary->Min = bucket->Min;
+			if (bucket->Max > summary->Max) summary->Max = bucket->Max;
+		}
+		if (t <= begin)
+			break;
+
+		// ---- Longest buckets that fit in the range and are still stored ---- //
+		while (level + 1 < TREND_LEVELS && !(t % TREND_len[level + 1]) && t - begin >= TREND_len[level + 1] &&
+			TREND_data.Closed[level + 1] - t / TREND_len[level + 1] < TREND_size[level + 1])
+			++level;
+		while (level > 0 && t - begin < TREND_len[level] &&
+			TREND_data.Closed[level - 1] <= TREND_size[level - 1] + begin / TREND_len[level - 1])
+			--level;
+
+		b = t / TREND_len[level] - 1;
+		if (TREND_data.Closed[level] - b > TREND_size[level])
+			break;
+		bucket = &TREND_data.Buf[TREND_offset[level] + b % TREND_size[level]];
+		t -= TREND_len[level];
+	}
+
+	if (summary->Beats)
+		summary->Mean = (uint16_t) (sum / summary->Beats);
+	else
+		summary->Min = 0;
+}
+#endif
+
+#if (PT_ALARM == 1)
+/************************************
+Sets the alarm thresholds, see PT_alarm_config. The defaults are
+asystole 4 sec, bradycardia 50/55 bpm, tachycardia 120/115 bpm and
+irregular rhythm 8/0 irregular beats.
+
+Input - config : Pointer to the thresholds
+*************************************/
+void PT_set_AlarmConfig(const struct PT_alarm_config *config) {
+	ALARM_config = *config;
+}
+
+// ------Returns the raised alarms, ALARM_ASYSTOLE | ALARM_BRADY | ALARM_TACHY | ALARM_IRREGULAR ------ //
+int16_t PT_get_AlarmState_output(void) {
+	return (ALARM_data.State);
+}
+
+/************************************
+Pops the oldest alarm event, returns 0 if there is none.
+
+Input - event : Pointer to the event
+*************************************/
+int16_t PT_get_AlarmEvent_output(struct PT_alarm_event *event) {
+	if (!ALARM_data.Count)
+		return (0);
+	*event = ALARM_data.Queue[ALARM_data.Head];
+	ALARM_data.Head = (ALARM_data.Head + 1) & (ALARM_QUEUE_SIZE - 1);
+	--ALARM_data.Count;
+	return (1);
+}
+#endif
+
+#if (PT_SQI == 1)
+// ------Returns the lead status, LEAD_OK, LEAD_FLAT, LEAD_SATURATED or LEAD_NOISY ------ //
+int16_t PT_get_LeadStatus_output(void) {
+	return (SQI_data.Status);
+}
+
+// ------Returns the derivative to BP energy ratio of the last second in Q8 (noise index) ------ //
+uint16_t PT_get_SQI_output(void) {
+	return (SQI_data.Noise);
+}
+#endif
+
+#if (PT_CLIP_STATS == 1)
+/************************************
+Returns a snapshot of the clamp counters of the filter chain,
+counted since PT_init or PT_clear_ClipStats. Growing counters
+mean the input gain is too high for the fixed-point range.
+
+Input - stats : Pointer to the counters
+*************************************/
+void PT_get_ClipStats_output(struct PT_clip_stats *stats) {
+	*stats = CLIP_data;
+}
+
+// ------Clears the clamp counters ------ //
+void PT_clear_ClipStats(void) {
+	memset(&CLIP_data, 0, sizeof(CLIP_data));
+}
+#endif
+
+#if (PT_AGC == 1)
+// ------Returns the gain of the front end as a power of two, filter outputs and thresholds are scaled by it ------ //
+int16_t PT_get_AGCShift_output(void) {
+	return (AGC_data.Shift);
+}
+#endif
+
+#if (PT_STAGE_OPS == 1)
+/************************************
+Replaces filter stages at run time, members left NULL keep the
+built-in stage and a NULL ops restores all of them. Call it
+before PT_init, which clears the stages. The user stages are
+not rescaled by PT_AGC.
+
+Input - ops : User stages, copied
+*************************************/
+void PT_set_StageOps(const struct PT_stage_ops *ops) {
+	if (ops)
+		STAGE_ops = *ops;
+	else
+		memset(&STAGE_ops, 0, sizeof(STAGE_ops));
+}
+#endif
+
+#if (PT_PREPROC == 1)
+/************************************
+Selects the preprocessing stages, any combination of PRE_NOTCH_50,
+PRE_NOTCH_60 and PRE_BASELINE (PRE_NONE to bypass them). The stages
+start from a cleared state and the delay of the notches is added to
+the beat delays. The selection is kept over PT_init.
+
+Input - mode : Stages to run
+*************************************/
+void PT_set_Preprocess(int16_t mode) {
+	PRE_mode = mode;
+	PRE_delay = ((mode & PRE_NOTCH_50) ? 1 : 0) + ((mode & PRE_NOTCH_60) ? 1 : 0);
+	memset(&PRE_data, 0, sizeof(PRE_data));
+}
+
+// ------Returns the selected preprocessing stages ------ //
+int16_t PT_get_Preprocess_output(void) {
+	return (PRE_mode);
+}
+#endif
+
+#if (PT_R_REFINE == 1)
+/************************************
+Returns the delay of the R apex of the last beat to the
+current sample in Q(RPK_Q), i.e. the R apex is at
+SampleCount - delay / 2^RPK_Q. Valid on the sample PT_StateMachine
+returns the beat, use instead of its coarse delay.
+*************************************/
+int32_t PT_get_RPeakDelayQ_output(void) {
+	return (RPK_data.DelayQ);
+}
+#endif
+
+#if (PT_TEMPLATE == 1)
+// ------Returns the class of the last beat, CLASS_UNKNOWN, CLASS_NORMAL or CLASS_ECTOPIC ------ //
+int16_t PT_get_BeatClass_output(void) {
+	return (TPL_data.Class);
+}
+
+// ------Returns the cluster of the last beat, -1 if not classified ------ //
+int16_t PT_get_BeatCluster_output(void) {
+	return (TPL_data.Cluster);
+}
+
+// ------Returns the correlation of the last beat with its template in Q8 ------ //
+int16_t PT_get_BeatCorr_output(void) {
+	return (TPL_data.Corr);
+}
+#endif
+
+#if (PT_EDR == 1)
+/************************************
+Pops the oldest EDR point (QRS amplitude minus its baseline,
+4 points per second), returns 0 if there is none. Points come
+in bursts at each beat.
+
+Input - val : Pointer to the point
+*************************************/
+int16_t PT_get_EDR_output(pt_sample_t *val) {
+	if (!EDR_data.Count)
+		return (0);
+	*val = EDR_data.Queue[EDR_data.Head];
+	EDR_data.Head = (EDR_data.Head + 1) & (EDR_QUEUE_SIZE - 1);
+	--EDR_data.Count;
+	return (1);
+}
+
+// ------Returns the respiratory rate in breaths per minute Q(RESP_Q), 0 if unknown ------ //
+uint16_t PT_get_RespRate_output(void) {
+	return (EDR_data.Rate);
+}
+#endif
+
+#if (PT_MULTILEAD == 1)
+/************************************
+Sets the weight of a lead in the fusion of PT_StateMachineLeads,
+ML_WEIGHT_ONE (1.0, default) to 4 * ML_WEIGHT_ONE, 0 leaves the lead
+out. Kept over PT_init.
+
+Input - lead   : 0 to PT_LEADS - 1
+        weight : Weight in Q8
+*************************************/
+void PT_set_LeadWeight(int16_t lead, int16_t weight) {
+	int16_t l;
+
+	if (lead < 0 || lead >= PT_LEADS)
+		return;
+	if (!ML_weight_set) {
+		for (l = 0; l < PT_LEADS; l++)
+			ML_weight[l] = ML_WEIGHT_ONE;
+		ML_weight_set = 1;
+	}
+	ML_weight[lead] = (weight < 0) ? 0 : ((weight > 4 * ML_WEIGHT_ONE) ? 4 * ML_WEIGHT_ONE : weight);
+	LeadWeights();
+}
+
+// ------Returns the fusion weight of a lead in Q8, 0 if unusable ------ //
+int16_t PT_get_LeadWeight_output(int16_t lead) {
+	return ((lead < 0 || lead >= PT_LEADS) ? 0 : ML_bank.Fuse_w[lead]);
+}
+#endif
+
+#if (PT_QRS_WIDTH == 1)
+// ------Returns the delay of the QRS onset of the last beat to the current sample ------ //
+int16_t PT_get_QRSOnset_output(void) {
+	return (QRS_data.Onset);
+}
+
+// ------Returns the delay of the QRS offset of the last beat to the current sample ------ //
+int16_t PT_get_QRSOffset_output(void) {
+	return (QRS_data.Offset);
+}
+
+// ------Returns the QRS width of the last beat in samples ------ //
+int16_t PT_get_QRSWidth_output(void) {
+	return (QRS_data.Width);
+}
+#endif
+
+#if (PT_SNAPSHOT == 1)
+// ------Returns the size of a snapshot in bytes ------ //
+uint32_t PT_get_SnapshotSize_output(void) {
+	return ((uint32_t) sizeof(struct PT_snap_head) + SnapCopy(NULL, 0));
+}
+#endif
+
+#if (PT_LOW_LATENCY == 1)
+/************************************
+Returns the provisional beat event of the most recent sample,
+BEAT_NONE, BEAT_PROVISIONAL, BEAT_CONFIRMED or BEAT_RETRACTED.
+*************************************/
+int16_t PT_get_BeatEvent_output(void) {
+	return (Beat_Event);
+}
+
+// ------Returns the delay of the provisional peak to the current sample ------ //
+int16_t PT_get_ProvisionalDelay_output(void) {
+	return (Prov_Delay);
+}
+#endif
\ No newline at end of file
@@ -14,6 +14,16 @@
 #define PT2000MS			((int16_t)	(400))
 #define PT4000MS			((int16_t)	(800))
 #define GENERAL_DELAY		((int16_t)	(38))
+#define BP_DELAY			((int16_t)	(21))		// LPFilter 5 + HPFilter 16, part of GENERAL_DELAY
+#define MVA_DELAY			((int16_t)	(15))		// Half the MVAFilter window, part of GENERAL_DELAY
+
+/************************************************************
+    Sampling frequency and heart-rate constants
+ ************************************************************/
+#define PT_FS				((int16_t)	(200))		// Sampling frequency assumed by the timing constants
+#define HR_Q				7							// Heart-rate fractional bits, beats per minute in Q7
+#define HR_RR_MIN			((int16_t)	(PT_FS / 5))	// Shortest RR of the heart-rate table (300 bpm)
+#define HR_TABLE_SIZE		((int16_t)	(768))		// RR range of the heart-rate table, covers PT4000MS
 
 /*************************************************************
 	RR Limits constants for startup (92,116, 166 % OF 200)
@@ -34,10 +44,45 @@
     PT constants
  ************************************************************/
 #define FILTER_FORM		2
+
+#ifndef PT_FUSED_BP
+#define PT_FUSED_BP			0		// LP and HP share one ring of BP_RING_SIZE taps (FILTER_FORM 2)
+#endif
+#define BP_RING_SIZE		((int16_t)	(32))		// Power of 2, covers LP_BUFFER_SIZE and HP_BUFFER_SIZE
+
+#ifndef PT_PRECISION
+#define PT_PRECISION		16		// 16: int16 samples and filters, 32: int32 samples and filters, int64 levels for 16/24-bit ADCs
+#endif
+
+#if (PT_PRECISION == 32)
+typedef int32_t		pt_sample_t;						// ECG sample, filter outputs and BP signal levels
+typedef uint64_t	pt_level_t;							// Squared and integrated signal levels
+typedef int64_t		pt_acc_t;							// Products and sums of samples
+
+#define SQR_LIM_VAL			((int32_t)  (0x1000000))	// Derivative of a full scale 24-bit input stays below it, squares fit 48 bits
+
+#define SQR_LIM_OUT			((uint64_t) (0x1000000000000))	// Hardlimiting output of Sqauring filter, 30 of them fit MV_sum
+#define MVA_LIM_VAL			((uint64_t)	(0x1000000000000))	// Limiting factor for MVA signal
+#define PT_LEVEL_MAX		UINT64_MAX
+#define PT_SAMPLE_MAX		INT32_MAX
+#define PT_SAMPLE_MIN		INT32_MIN
+#define LP_SIGN_FILL		((pt_sample_t) 0xF8000000)	// Sign of w >> 5
+#define HP_SIGN_FILL		((pt_sample_t) 0x80000000)	// Sign of y_h >> 1
+#else
+typedef int16_t		pt_sample_t;
+typedef uint16_t	pt_level_t;
+typedef int32_t		pt_acc_t;
+
 #define SQR_LIM_VAL			((int16_t)  (256))		// We have to limit the Squaring function to avoid overflow once squaring numbers.
 
 #define SQR_LIM_OUT			((uint16_t) (30000))	// Hardlimiting output of Sqauring filter
 #define MVA_LIM_VAL			((int16_t)	(32000))	// Limiting factor for MVA signal
+#define PT_LEVEL_MAX		UINT16_MAX
+#define PT_SAMPLE_MAX		INT16_MAX
+#define PT_SAMPLE_MIN		INT16_MIN
+#define LP_SIGN_FILL		0xF800
+#define HP_SIGN_FILL		0xF800
+#endif
 
  // values for State-Machine: PT_data.PT_state
 #define START_UP		0
@@ -52,34 +97,256 @@
 #define REGULAR_HR			0
 
 
+/************************************************************
+    Optional features (0: disabled, 1: enabled)
+ ************************************************************/
+#ifndef PT_LOW_LATENCY
+#define PT_LOW_LATENCY		0		// Report provisional beats as soon as a peak passes ThI1 and ThF1
+#endif
+
+#ifndef PT_HRV
+#define PT_HRV				0		// Time-domain HRV (SDNN, RMSSD, pNN50) over a sliding window
+#endif
+#ifndef PT_HRV_WINDOW
+#define PT_HRV_WINDOW		((uint32_t)	(300 * (uint32_t) PT_FS))	// HRV window, 5 minutes
+#endif
+#ifndef PT_HRV_BUFFER_SIZE
+#define PT_HRV_BUFFER_SIZE	2048	// RR intervals kept for the window (power of 2), 5 min up to 400 bpm
+#endif
+#ifndef PT_HRV_SKIP_IRREGULAR
+#define PT_HRV_SKIP_IRREGULAR	1		// Exclude intervals flagged as irregular from HRV
+#endif
+
+#ifndef PT_LFHF
+#define PT_LFHF				0		// Frequency-domain HRV (LF and HF power) of the resampled RR series
+#endif
+
+#ifndef PT_HRSTAT
+#define PT_HRSTAT			0		// Rolling heart-rate min, max and percentiles over 1, 5 and 60 minutes
+#endif
+#ifndef PT_HRSTAT_BUFFER_SIZE
+#define PT_HRSTAT_BUFFER_SIZE	8192	// Beats kept for the longest window (power of 2), 60 min up to 136 bpm
+#endif
+
+#ifndef PT_TREND
+#define PT_TREND			0		// Heart-rate trend summaries per 10 sec, 1 min, 10 min and 1 hour
+#endif
+
+#ifndef PT_ALARM
+#define PT_ALARM			0		// Asystole, bradycardia, tachycardia and irregular rhythm alarms
+#endif
+#define ALARM_QUEUE_SIZE	16		// Alarm events waiting to be read (power of 2)
+
+#ifndef PT_AGC
+#define PT_AGC				0		// Automatic gain control in front of LPFilter, power-of-two steps
+#endif
+#define AGC_BLOCK			PT2000MS					// Envelope (max |DRF_val|) measured over 2 seconds
+#if (PT_PRECISION == 32)
+#define AGC_REF				(SQR_LIM_VAL >> 2)			// Envelope reference, a quarter of the clamp keeps w of LPFilter in int32
+#else
+#define AGC_REF				SQR_LIM_VAL
+#endif
+#define AGC_HIGH			((AGC_REF >> 2) * 3)		// Gain down once the envelope gets close to AGC_REF
+#define AGC_LOW				(AGC_REF >> 2)				// Gain up once the envelope stays below a quarter of it
+#define AGC_UP_BLOCKS		2							// Quiet blocks before a gain up
+#define AGC_SHIFT_MAX		4							// Largest gain, 2^4
+#define AGC_SHIFT_MIN		(-4)						// Smallest gain, 2^-4
+
+#ifndef PT_SQI
+#define PT_SQI				0		// Signal quality index, decision logic is skipped on unusable leads
+#endif
+#ifndef SQI_FLAT_RANGE
+#define SQI_FLAT_RANGE		((int16_t)	(4))		// Input range (ADC counts) of a flat lead over one second
+#endif
+#ifndef SQI_RAIL_HIGH										// Define both rails to override them
+#if (PT_PRECISION == 32)
+#define SQI_RAIL_HIGH		((pt_sample_t)	(8388607))	// ADC rails (24-bit), half a second at the rails is a saturated lead
+#define SQI_RAIL_LOW		((pt_sample_t)	(-8388608))
+#else
+#define SQI_RAIL_HIGH		((pt_sample_t)	(32767))	// ADC rails, half a second at the rails is a saturated lead
+#define SQI_RAIL_LOW		((pt_sample_t)	(-32768))
+#endif
+#endif
+#ifndef SQI_NOISE_LIM
+#if (PT_AGC == 1 || PT_PRECISION == 32)
+#define SQI_NOISE_LIM		((uint16_t)	(80))		// Derivative to BP energy ratio (Q8) of a noisy lead, ECG 30 - 76 at high resolution, noise > 84
+#else
+#define SQI_NOISE_LIM		((uint16_t)	(72))		// Derivative to BP energy ratio (Q8) of a noisy lead, ECG ~ 40
+#endif
+#endif
+#define SQI_GOOD_BLOCKS		2							// Good seconds before a lead is usable again
+
+#ifndef PT_CLIP_STATS
+#define PT_CLIP_STATS		0		// Count every clamp of the filter chain (saturation telemetry)
+#endif
+
+#ifndef PT_PREPROC
+#define PT_PREPROC			0		// Powerline notch and baseline wander stages in front of LPFilter
+#endif
+#define PRE_BASE_SHIFT		6		// Baseline blocker pole 1 - 2^-6, -3 dB at 0.5 Hz
+#define PRE_NOTCH60_A		((pt_acc_t)	(12517))	// 60 Hz notch (1 - 2cos(0.6 pi) z^-1 + z^-2) / 2.618 in Q15
+#define PRE_NOTCH60_B		((pt_acc_t)	(7735))
+
+#ifndef PT_OFFLINE
+#define PT_OFFLINE			0		// Zero-phase processing of whole records, see PT_Offline
+#endif
+#define OFFLINE_LEARN		((int32_t)	(10 * (int32_t) PT_FS))	// Lookahead of the initial thresholds, 10 sec
+#define OFFLINE_R_WIN		((int16_t)	(PT_FS / 20))	// R peak searched within +-50 msec of the beat
+
+#ifndef PT_R_REFINE
+#define PT_R_REFINE			0		// R apex located on the input signal with sub-sample precision
+#endif
+#define RPK_RING_SIZE		((int16_t)	(512))		// Power of 2, input history, covers most search-back beats (2.5 sec)
+#define RPK_WIN				((int16_t)	(PT_FS / 10))	// R apex searched within +-100 msec of the beat
+#define RPK_Q				8							// Fractional bits of the R apex delay
+
+#ifndef PT_QRS_WIDTH
+#define PT_QRS_WIDTH		0		// QRS onset, offset and width of each beat
+#endif
+#define QRS_SLOPE_SHIFT		1		// Slope threshold of the onset and offset, half the previous QRS slope
+
+#ifndef PT_TEMPLATE
+#define PT_TEMPLATE			0		// Beat templates and morphology clusters, uses the PT_R_REFINE history
+#endif
+#define TPL_COUNT			4							// Templates (clusters) kept
+#define TPL_LEN				((int16_t)	(32))		// Beat window, 160 msec
+#define TPL_PRE				((int16_t)	(12))		// Samples of the window before the R apex
+#define TPL_AMP				((int16_t)	(1024))		// Peak of the normalized beats and templates
+#define TPL_MATCH			((int16_t)	(230))		// Correlation to join a cluster, 0.9 in Q8
+#define TPL_ADAPT			3							// Templates move 1/8 towards each new beat
+#define TPL_LEARN			8							// Beats in the largest cluster before labelling
+
+#ifndef PT_MULTILEAD
+#define PT_MULTILEAD		0		// PT_StateMachineLeads, PT_LEADS leads fused into one beat stream
+#endif
+#ifndef PT_LEADS
+#define PT_LEADS			12		// Leads of PT_StateMachineLeads
+#endif
+#define ML_WEIGHT_ONE		((int16_t)	(256))		// Lead weight 1.0 in Q8, see PT_set_LeadWeight
+
+#ifndef PT_EDR
+#define PT_EDR				0		// ECG-derived respiration from the QRS amplitude and respiratory rate
+#endif
+#define EDR_STEP			((int16_t)	(PT_FS / 4))	// Beat amplitudes resampled at 4 Hz
+#define EDR_QUEUE_SIZE		16							// EDR points waiting to be read (power of 2)
+#define EDR_BASE_SHIFT		6							// Amplitude baseline over 2^6 points, 16 sec
+#define EDR_MIN_PERIOD		((int16_t)	(6))		// Shortest breath in points, 1.5 sec (40 breaths/min)
+#define EDR_MAX_PERIOD		((int16_t)	(48))		// Longest breath in points, 12 sec (5 breaths/min)
+#define EDR_BREATHS			4							// Breaths averaged by the rate
+#define RESP_Q				4							// Respiratory rate fractional bits, breaths per minute in Q4
+
+#ifndef PT_GAP
+#define PT_GAP				0		// PT_Gap, missing samples of dropped packets
+#endif
+#define GAP_WARMUP			MVA_BUFFER_SIZE				// Samples without decisions after a gap
+
+#ifndef PT_SNAPSHOT
+#define PT_SNAPSHOT			0		// PT_Snapshot, PT_Restore and PT_Seek, detector state saved and restored
+#endif
+#define SNAP_MAGIC			((uint32_t)	(0x31535450))	// "PTS1"
+
+#ifndef PT_BEATFILE
+#define PT_BEATFILE			0		// PanTompkinsCMD also writes output.beats, needs PanTompkinsBeatFile.c
+#endif
+#ifndef PT_BEATDB
+#define PT_BEATDB			0		// PanTompkinsCMD also appends to output.db, needs PanTompkinsBeatDB.c
+#endif
+
+#ifndef PT_STAGE_OPS
+#define PT_STAGE_OPS		0		// Filter stages replaceable at run time, see PT_set_StageOps
+#endif
+
+/************************************************************
+    User filter stages at compile time. Define any of
+    PT_STAGE_BANDPASS(x)	pt_sample_t from the input sample (LPFilter and HPFilter)
+    PT_STAGE_DERIV(bp)		pt_sample_t from the BP signal (DerivFilter)
+    PT_STAGE_SQUARE(dr)		pt_level_t from the derivative (SQRFilter)
+    PT_STAGE_INTEGRATE(sq)	pt_level_t from the squared signal (MVAFilter)
+    PT_STAGE_RESET()		clears the user stages (PT_init and emergency reset)
+    in the file named by PT_STAGE_HEADER, e.g. -DPT_STAGE_HEADER=\"MyStages.h\".
+ ************************************************************/
+#ifdef PT_STAGE_HEADER
+#include PT_STAGE_HEADER
+#endif
+#ifndef PT_STAGE_DELAY
+#define PT_STAGE_DELAY		0		// Delay of the user stages minus the delay of the stages they replace
+#endif
+
+// Beat events reported by PT_get_BeatEvent_output (PT_LOW_LATENCY)
+#define BEAT_NONE			0
+#define BEAT_PROVISIONAL	1		// Peak above thresholds, blanking time still running
+#define BEAT_CONFIRMED		2		// Provisional beat has been reported as a beat
+#define BEAT_RETRACTED		3		// Provisional beat has been classified as noise or T-wave
+
+// Beat classes (PT_TEMPLATE), PT_get_BeatClass_output
+#define CLASS_UNKNOWN		0		// Templates still learning or beat outside the history
+#define CLASS_NORMAL		1		// Beat in the largest cluster
+#define CLASS_ECTOPIC		2		// Beat in another cluster
+
+// Alarms (PT_ALARM), bits of PT_get_AlarmState_output
+#define ALARM_ASYSTOLE		0x01
+#define ALARM_BRADY			0x02
+#define ALARM_TACHY			0x04
+#define ALARM_IRREGULAR		0x08
+#define ALARM_LEAD_OFF		0x10		// Lead unusable (PT_SQI)
+
+// Lead status (PT_SQI), PT_get_LeadStatus_output
+#define LEAD_OK				0
+#define LEAD_FLAT			1
+#define LEAD_SATURATED		2
+#define LEAD_NOISY			3
+
+// Preprocessing stages (PT_PREPROC), flags of PT_set_Preprocess
+#define PRE_NONE			0x00
+#define PRE_NOTCH_50		0x01		// 50 Hz FIR notch (x[n] + x[n-2]) / 2, delay 1 sample
+#define PRE_NOTCH_60		0x02		// 60 Hz FIR notch, delay 1 sample (both notches add up)
+#define PRE_BASELINE		0x04		// Baseline wander (DC) blocker, no delay at QRS frequencies
+
+
 
 /************************************************************
     Data types
  ************************************************************/
+#if (PT_FUSED_BP == 1)
+#if (FILTER_FORM != 2)
+#error "PT_FUSED_BP fuses the FILTER_FORM 2 filters"
+#endif
+
+struct PT_bp_tap								// One sample of the fused bandpass
+{
+	pt_sample_t X;								//  Input of LPFilter
+	pt_sample_t V;								//  Output of LPFilter, input of HPFilter
+};
+#endif
+
 struct PT_struct
 {
+#if (PT_FUSED_BP == 1)
+	int16_t BP_pointer;
+#else
 	int16_t LP_pointer;
 	int16_t HP_pointer;
+#endif
 	int16_t MVA_pointer;
 	int16_t	PT_state;							//	State of the process
 	int16_t Recent_RR_M;						//	Mean of most recent RR
 	
-	int16_t LPF_val;
-	int16_t HPF_val;
-	int16_t DRF_val;
-	uint16_t SQF_val;
-	uint16_t MVA_val;
+	pt_sample_t LPF_val;
+	pt_sample_t HPF_val;
+	pt_sample_t DRF_val;
+	pt_level_t SQF_val;
+	pt_level_t MVA_val;
 	
 
-	uint16_t ThI1;								// Threshold I1 (Integrated signal)
-	uint16_t SPKI;								// Signal peak estimate Integrated
-	uint16_t NPKI;								// Noise peak estimate Integrated
-	uint16_t ThI2;								// Threshold I2 (Integrated signal)
+	pt_level_t ThI1;							// Threshold I1 (Integrated signal)
+	pt_level_t SPKI;							// Signal peak estimate Integrated
+	pt_level_t NPKI;							// Noise peak estimate Integrated
+	pt_level_t ThI2;							// Threshold I2 (Integrated signal)
 	
-	int16_t ThF1;								// Threshold F1 (Band-passed signal)
-	int16_t SPKF;								// Signal peak estimate BP
-	int16_t NPKF;								// Noise peak estimate BP
-	int16_t ThF2;								// Threshold F2 (Band-passed signal)
+	pt_sample_t ThF1;							// Threshold F1 (Band-passed signal)
+	pt_sample_t SPKF;							// Signal peak estimate BP
+	pt_sample_t NPKF;							// Noise peak estimate BP
+	pt_sample_t ThF2;							// Threshold F2 (Band-passed signal)
 
 	int16_t RR_M;								//  General mean of RR within acceptable range
 	int16_t RR_Low_L;							//	RR Low limit 
@@ -87,49 +354,520 @@ struct PT_struct
 	int16_t RR_Missed_L;						//	RR missed limit 
 	int16_t HR_State;							//  HR-State can be regular or irregular
 
-	int16_t LP_buf[LP_BUFFER_SIZE];				//  LP filter buffer
-	int16_t HP_buf[HP_BUFFER_SIZE];				//  HP filter buffer
-	int16_t DR_buf[DR_BUFFER_SIZE];				//  DR filter buffer
-	uint16_t MVA_buf[MVA_BUFFER_SIZE];			//  MVA filter buffer
+#if (PT_FUSED_BP == 1)
+	struct PT_bp_tap BP_ring[BP_RING_SIZE];		//  Fused LP and HP filter buffer
+#else
+	pt_sample_t LP_buf[LP_BUFFER_SIZE];			//  LP filter buffer
+	pt_sample_t HP_buf[HP_BUFFER_SIZE];			//  HP filter buffer
+#endif
+	pt_sample_t DR_buf[DR_BUFFER_SIZE];			//  DR filter buffer
+	pt_level_t MVA_buf[MVA_BUFFER_SIZE];		//  MVA filter buffer
 	int16_t RR_AVRG1_buf[RR_BUFFER_SIZE];		//  RR average 1 buffer
 	int16_t RR_AVRG2_buf[RR_BUFFER_SIZE];		//  RR average 2 buffer
 };
 
+#if (PT_HRV == 1)
+struct PT_hrv_struct							// Running sums of the sliding HRV window, RR in samples
+{
+	uint32_t Win_Len;							//  Samples covered by the window
+	uint32_t Sum;								//  Sum of RR
+	uint64_t Sum_sq;							//  Sum of RR^2
+	uint64_t Sum_diff_sq;						//  Sum of squared successive differences
+	uint16_t N;									//  Number of RR
+	uint16_t N_diff;							//  Number of successive differences
+	uint16_t NN50;								//  Successive differences above 50 msec
+	int16_t Prev_RR;							//  Previous RR, 0 if the chain is broken
+	uint16_t Head;								//  Oldest interval of the ring
+	uint16_t Count;								//  Intervals in the ring
+	int16_t Full;								//  The window has been covered once
+	int16_t RR[PT_HRV_BUFFER_SIZE];				//  RR of each interval of the window
+	int16_t Diff[PT_HRV_BUFFER_SIZE];			//  Difference to the previous RR, -1 if not counted
+	uint8_t Used[PT_HRV_BUFFER_SIZE];			//  1 if the RR is counted (not skipped as irregular)
+};
+
+struct PT_hrv_stats								// HRV statistics of a window
+{
+	uint16_t Beats;								//  Number of RR intervals
+	uint16_t MeanNN;							//  Mean RR (msec)
+	uint16_t SDNN;								//  Standard deviation of RR (msec)
+	uint16_t RMSSD;								//  Root mean square of successive differences (msec)
+	uint16_t pNN50;								//  Successive differences above 50 msec (0.01 %)
+};
+#endif
+
+#if (PT_LFHF == 1)
+#define LFHF_STEP			((int16_t)	(PT_FS / 4))	// RR series resampled at 4 Hz
+#define LFHF_N				((int16_t)	(256))		// Points per spectrum, 64 sec
+#define LFHF_LF_BINS		7							// LF bins k = 3 - 9, 0.047 - 0.141 Hz
+#define LFHF_BINS			23							// LF and HF bins k = 3 - 25, HF 0.156 - 0.391 Hz
+
+struct PT_lfhf_struct							// Resampler and Goertzel bank, RR in samples Q4
+{
+	int32_t S1[LFHF_BINS];						//  Goertzel state s[n-1]
+	int32_t S2[LFHF_BINS];						//  Goertzel state s[n-2]
+	int16_t Prev_RR;							//  RR of the previous beat, 0 before the first beat
+	int16_t Phase;								//  Next grid point, samples after the previous beat
+	int16_t Offset;								//  First point of the block (Q4), removed from the input
+	int16_t N;									//  Points in the block
+};
+
+struct PT_lfhf_stats							// Spectral HRV of a block
+{
+	uint32_t LF;								//  Power 0.04 - 0.15 Hz (msec^2)
+	uint32_t HF;								//  Power 0.15 - 0.4 Hz (msec^2)
+	uint16_t Ratio;								//  LF/HF in Q8
+};
+#endif
+
+#if (PT_HRSTAT == 1)
+#define HRSTAT_WINDOWS		3							// Windows of 1, 5 and 60 minutes, see HRSTAT_win_len
+#define HRSTAT_BINS			256							// 1 bpm histogram bins, also bounds the monotone deques
+
+struct PT_hrstat_win							// Heart-rate statistics of one window
+{
+	uint32_t Tail;								//  Oldest beat (sequence number) in the window
+	uint32_t Max_q[HRSTAT_BINS];				//  Monotone deque of beats, decreasing HR
+	uint32_t Min_q[HRSTAT_BINS];				//  Monotone deque of beats, increasing HR
+	uint16_t Max_h, Max_n;						//  Head and length of Max_q
+	uint16_t Min_h, Min_n;						//  Head and length of Min_q
+	uint16_t Count;								//  Beats in the window
+	uint16_t Hist[HRSTAT_BINS];					//  Heart-rate histogram of the window
+};
+
+struct PT_hrstat_struct							// Beat history shared by the windows
+{
+	uint32_t Seq;								//  Sequence number of the next beat
+	uint32_t Time[PT_HRSTAT_BUFFER_SIZE];		//  Sample clock of each beat
+	uint8_t HR[PT_HRSTAT_BUFFER_SIZE];			//  Heart rate of each beat (bpm)
+	struct PT_hrstat_win Win[HRSTAT_WINDOWS];
+};
+
+struct PT_hrstat_stats							// Heart-rate statistics returned to the user (bpm)
+{
+	uint16_t Beats;
+	uint16_t Min;
+	uint16_t Max;
+	uint16_t Median;
+};
+#endif
+
+#if (PT_TREND == 1)
+#define TREND_LEVELS		4							// Bucket lengths, see TREND_len
+#define TREND_BUFFER_SIZE	((int16_t)	(720))		// Buckets of all levels, see TREND_size
+
+struct PT_trend_bucket							// Heart-rate summary of a bucket, HR in Q(HR_Q)
+{
+	uint32_t Sum;								//  Sum of HR
+	uint16_t Min;								//  Minimum HR, UINT16_MAX if no beat
+	uint16_t Max;								//  Maximum HR
+	uint16_t Beats;								//  Number of beats
+};
+
+struct PT_trend_struct
+{
+	struct PT_trend_bucket Buf[TREND_BUFFER_SIZE];	//  Closed buckets, one ring per level
+	struct PT_trend_bucket Cur[TREND_LEVELS];		//  Open bucket of each level
+	uint32_t Closed[TREND_LEVELS];					//  Buckets closed per level
+	uint32_t Start;									//  Sample clock at the start of the open 10 sec bucket
+};
+
+struct PT_trend_summary							// Heart-rate summary returned to the user, HR in Q(HR_Q)
+{
+	uint32_t Beats;
+	uint16_t Min;
+	uint16_t Max;
+	uint16_t Mean;
+};
+#endif
+
+#if (PT_ALARM == 1)
+struct PT_alarm_config							// Alarm thresholds, raise and clear levels give the hysteresis
+{
+	int16_t Asystole;							//  No beat for this many samples
+	int16_t Brady_On;							//  Raise bradycardia below this heart rate (bpm)
+	int16_t Brady_Off;							//  Clear bradycardia above this heart rate (bpm)
+	int16_t Tachy_On;							//  Raise tachycardia above this heart rate (bpm)
+	int16_t Tachy_Off;							//  Clear tachycardia below this heart rate (bpm)
+	int16_t Irregular_On;						//  Raise once the irregular beat count reaches this value
+	int16_t Irregular_Off;						//  Clear once the count is down to this value
+};
+
+struct PT_alarm_event
+{
+	uint32_t Time;								//  Sample clock of the event
+	int16_t Alarm;								//  ALARM_ASYSTOLE, ALARM_BRADY, ALARM_TACHY or ALARM_IRREGULAR
+	int16_t Raised;								//  1 if raised, 0 if cleared
+};
+
+struct PT_alarm_struct
+{
+	struct PT_alarm_event Queue[ALARM_QUEUE_SIZE];	//  Events waiting to be read
+	uint16_t Head;								//  Oldest event
+	uint16_t Count;								//  Events in the queue
+	uint16_t Lost;								//  Events dropped because the queue was full
+	int16_t State;								//  Raised alarms
+	int16_t Since_Beat;							//  Samples since the last beat
+	int16_t Irregular_Cnt;						//  Up-down count of irregular beats
+};
+#endif
+
+#if (PT_SQI == 1)
+struct PT_sqi_struct							// Signal quality over blocks of one second
+{
+#if (PT_PRECISION == 32)
+	uint64_t Sum_HP;							//  Sum of |HPF_val|
+	uint64_t Sum_DR;							//  Sum of |DRF_val|
+#else
+	uint32_t Sum_HP;							//  Sum of |HPF_val|
+	uint32_t Sum_DR;							//  Sum of |DRF_val|
+#endif
+	pt_sample_t Min, Max;						//  Input range
+	int16_t Rail_Cnt;							//  Samples at the ADC rails
+	int16_t Cnt;								//  Samples in the block
+	int16_t Good_Blocks;						//  Consecutive good blocks
+	int16_t Status;								//  LEAD_OK, LEAD_FLAT, LEAD_SATURATED or LEAD_NOISY
+	uint16_t Noise;								//  Derivative to BP energy ratio of the last block (Q8)
+};
+#endif
+
+#if (PT_CLIP_STATS == 1)
+struct PT_clip_stats							// Number of samples clamped at each point of the filter chain
+{
+	uint32_t LP_Sign;							//  LPFilter output changed by the | 0xF800 sign fill
+	uint32_t HP_Sign;							//  HPFilter output changed by the | 0xF800 sign fill
+	uint32_t SQR_In;							//  |DRF_val| above SQR_LIM_VAL
+	uint32_t SQR_Out;							//  Square above SQR_LIM_OUT
+	uint32_t MVA_Sum;							//  MV_sum limited to UINT16_MAX
+	uint32_t MVA_Lim;							//  MVA_val limited to MVA_LIM_VAL
+};
+#endif
+
+#if (PT_AGC == 1)
+#if (FILTER_FORM != 2)
+#error "PT_AGC recomputes the filter states of FILTER_FORM 2 only"
+#endif
+
+struct PT_agc_struct							// Gain of the front end and envelope of the current block
+{
+	int16_t Shift;								//  Gain applied to the input, 2^Shift
+	int16_t Cnt;								//  Samples in the block
+	int16_t Quiet_Blocks;						//  Consecutive blocks below AGC_LOW
+	pt_sample_t Env;							//  Max |DRF_val| of the block
+};
+#endif
+
+#if (PT_PREPROC == 1)
+struct PT_pre_struct							// State of the preprocessing stages
+{
+	pt_acc_t Base_acc;							//  Baseline blocker output in Q(PRE_BASE_SHIFT)
+	pt_sample_t Base_x;							//  Previous input of the baseline blocker
+	pt_sample_t N50_x[2];						//  Inputs x[n-1], x[n-2] of the 50 Hz notch
+	pt_sample_t N60_x[2];						//  Inputs x[n-1], x[n-2] of the 60 Hz notch
+	int16_t Primed;								//  Histories hold the first sample, no start-up step
+};
+#endif
+
+#if (PT_R_REFINE == 1)
+struct PT_rpk_struct							// Input history and the last R apex
+{
+	pt_sample_t Ring[RPK_RING_SIZE];			//  Input samples, newest at Idx - 1
+	uint16_t Idx;								//  Next write position
+	int32_t DelayQ;								//  Delay of the last R apex to the current sample in Q(RPK_Q)
+};
+#endif
+
+#if (PT_TEMPLATE == 1)
+#if (PT_R_REFINE != 1)
+#error "PT_TEMPLATE takes the beats from the PT_R_REFINE history"
+#endif
+
+struct PT_tpl_struct							// Beat templates, normalized to a peak of TPL_AMP
+{
+	int16_t Tpl[TPL_COUNT][TPL_LEN];			//  Templates
+	int32_t Energy[TPL_COUNT];					//  Sum of squares of each template
+	uint16_t Count[TPL_COUNT];					//  Beats in each cluster, 0 if the slot is free
+	int16_t Beat[TPL_LEN];						//  Normalized window of the last beat
+	int16_t Cluster;							//  Last beat: cluster, -1 if not classified
+	int16_t Corr;								//  Last beat: correlation with its template in Q8
+	int16_t Class;								//  Last beat: CLASS_UNKNOWN, CLASS_NORMAL or CLASS_ECTOPIC
+};
+#endif
+
+#if (PT_EDR == 1)
+struct PT_edr_struct							// Resampled QRS amplitude and breath detector
+{
+	pt_sample_t Queue[EDR_QUEUE_SIZE];			//  EDR points waiting to be read
+	uint16_t Head;								//  Oldest point
+	uint16_t Count;								//  Points in the queue
+	uint16_t Lost;								//  Points dropped because the queue was full
+	pt_sample_t Prev_Amp;						//  Amplitude of the previous beat, 0 before the first one
+	int16_t Phase;								//  Samples from the previous beat to the next point
+	pt_acc_t Base;								//  Amplitude baseline in Q(EDR_BASE_SHIFT)
+	pt_sample_t Env;							//  Mean |EDR|, the zero-crossing hysteresis is a quarter of it
+	int16_t Sign;								//  Side of the last crossing, 0 before the first one
+	int16_t Since;								//  Points since the last upward crossing
+	int16_t Period[EDR_BREATHS];				//  Last breath periods in points
+	int16_t Period_p;							//  Oldest period
+	int16_t N;									//  Valid periods
+	uint16_t Rate;								//  Respiratory rate in Q(RESP_Q), 0 if unknown
+};
+#endif
+
+#if (PT_MULTILEAD == 1)
+#if (FILTER_FORM != 2)
+#error "PT_MULTILEAD runs the FILTER_FORM 2 filters"
+#endif
+
+struct PT_lead_bank								// Filters of all leads, the lead is the inner index
+{
+	pt_sample_t X[BP_RING_SIZE][PT_LEADS];		//  Inputs of the LP filters
+	pt_sample_t V[BP_RING_SIZE][PT_LEADS];		//  LP outputs, inputs of the HP filters
+	pt_sample_t LP_y_old[PT_LEADS];				//  LP filter states
+	pt_sample_t LP_y_new[PT_LEADS];
+	pt_sample_t Y_h[PT_LEADS];					//  HP filter states
+	pt_sample_t DR_buf[DR_BUFFER_SIZE][PT_LEADS];	//  Derivative filter inputs
+	int16_t Pointer;							//  Ring position, holds x[n - 32] and v[n - 32]
+	int16_t Fuse_w[PT_LEADS];					//  Fusion weights in Q8, sum 256 over the usable leads
+	int16_t Usable[PT_LEADS];					//  Lead passed the last quality block
+	int16_t Good_Blocks[PT_LEADS];				//  Good blocks since the lead was lost
+	pt_sample_t Min[PT_LEADS];					//  Input range of the block
+	pt_sample_t Max[PT_LEADS];
+	int16_t Rail_Cnt[PT_LEADS];					//  Samples at the ADC rails
+	pt_acc_t Sum_HP[PT_LEADS];					//  Sum of |BP|
+	pt_acc_t Sum_DR[PT_LEADS];					//  Sum of |derivative|
+	int16_t Cnt;								//  Samples in the block
+};
+#endif
+
+#if (PT_QRS_WIDTH == 1)
+// Rising edges of the integrated signal tracked by QRSEdge
+#define QRS_PEAK			0			// Edge of the peak found on this sample
+#define QRS_HELD			1			// Edge of the peak held during the blanking time
+#define QRS_SB				2			// Edge of the search-back peak
+
+struct PT_qrs_struct							// QRS boundaries, times in Sample_Clock
+{
+	uint32_t Edge_Start;						//  First sample of the current MVA rising edge
+	uint32_t Slope_First;						//  First sample of the edge above the slope threshold, 0 if none
+	uint32_t Slope_Last;						//  Last sample of the edge above the slope threshold
+	pt_level_t Prev_MVA;						//  MVA_val of the previous sample
+	uint32_t On[3];								//  Onsets, indexed by QRS_PEAK, QRS_HELD and QRS_SB
+	uint32_t Off[3];							//  Offsets
+	int16_t Onset;								//  Last beat: delay of the onset to the current sample
+	int16_t Offset;								//  Last beat: delay of the offset to the current sample
+	int16_t Width;								//  Last beat: QRS width in samples
+};
+#endif
+
+#if (PT_SNAPSHOT == 1)
+struct PT_snap_head								// Start of each snapshot, the state follows
+{
+	uint32_t Magic;								//  SNAP_MAGIC
+	uint32_t Config;							//  Sampling rate, sample width and options of the build
+	uint32_t Size;								//  Bytes of the snapshot, head included
+	uint32_t Clock;								//  Sample_Clock of the snapshot
+};
+#endif
+
+#if (PT_STAGE_OPS == 1)
+struct PT_stage_ops								// User filter stages, NULL keeps the built-in stage
+{
+	pt_sample_t (*Bandpass)(pt_sample_t x);		//  Replaces LPFilter and HPFilter, returns the BP signal
+	pt_sample_t (*Deriv)(pt_sample_t bp);		//  Replaces DerivFilter
+	pt_level_t (*Square)(pt_sample_t dr);		//  Replaces SQRFilter
+	pt_level_t (*Integrate)(pt_level_t sq);		//  Replaces MVAFilter
+	void (*Reset)(void);						//  Clears the user stages, called by ResetDetector
+	int16_t Delay;								//  Delay of the user stages minus the delay of the stages they replace
+};
+#endif
+
 /**********************************************************************
     Function Prototypes
  **********************************************************************/
 void PT_init(void);
-int16_t PT_StateMachine(int16_t datum);
-void LearningPhase1(uint16_t *pkI, int16_t *pkBP);
-void LPFilter(int16_t *val);
+void ResetDetector(void);
+int16_t PT_StateMachine(pt_sample_t datum);
+int16_t BeatDecision(pt_level_t PEAKI);
+#if (PT_OFFLINE == 1)
+int32_t PT_Offline(const pt_sample_t *x, int32_t n, pt_sample_t *work, int32_t *peaks, int32_t max_peaks);
+void OfflineLearn(const pt_sample_t *bp, int32_t n);
+#endif
+void LearningPhase1(pt_level_t *pkI, pt_sample_t *pkBP);
+#if (PT_FUSED_BP == 1)
+void BPFilter(pt_sample_t *val);
+#else
+void LPFilter(pt_sample_t *val);
 void HPFilter(void);
+#endif
 void DerivFilter(void);
 void SQRFilter(void);
 void MVAFilter(void);
-int16_t PeakDtcI(void);
-void PeakDtcDR(int16_t DR_sample);
-void PeakDtcBP(int16_t DR_sample);
+pt_level_t PeakDtcI(void);
+void PeakDtcDR(pt_sample_t DR_sample);
+void PeakDtcBP(pt_sample_t DR_sample);
 void UpdateRR(int16_t qrs);
-void UpdateThI(uint16_t *PEAKI, int8_t NOISE_F);
-void UpdateThF(int16_t *PEAKF, int8_t NOISE_F);
+void UpdateThI(pt_level_t *PEAKI, int8_t NOISE_F);
+void UpdateThF(pt_sample_t *PEAKF, int8_t NOISE_F);
+#if (PT_HRV == 1)
+void HRVUpdate(int16_t qrs);
+void HRVExpire(void);
+void HRVStats(const struct PT_hrv_struct *hrv, struct PT_hrv_stats *stats);
+#endif
+#if (PT_HRV == 1 || PT_TEMPLATE == 1)
+uint32_t ISqrt(uint64_t x);
+#endif
+#if (PT_LFHF == 1)
+void LFHFUpdate(int16_t qrs);
+void LFHFPoint(int16_t val);
+#endif
+#if (PT_HRSTAT == 1)
+void HRStatUpdate(int16_t qrs);
+void HRStatExpire(struct PT_hrstat_win *win, uint32_t win_len);
+#endif
+#if (PT_TREND == 1)
+void TrendUpdate(int16_t qrs);
+void TrendAdvance(void);
+void TrendMerge(struct PT_trend_bucket *dst, const struct PT_trend_bucket *src);
+#endif
+#if (PT_ALARM == 1)
+void AlarmUpdate(int16_t BeatDelay);
+void AlarmSet(int16_t alarm, int16_t raised);
+#endif
+#if (PT_SQI == 1)
+void SQIUpdate(pt_sample_t datum);
+void LeadRestored(void);
+#endif
+#if (PT_AGC == 1)
+void AGCUpdate(pt_sample_t *datum);
+void AGCRescale(int16_t up);
+pt_sample_t AGCScale(pt_sample_t val, int16_t shift);
+pt_level_t AGCScaleLevel(pt_level_t val, int16_t shift);
+#endif
+#if (PT_PREPROC == 1)
+void Preprocess(pt_sample_t *datum);
+#endif
+#if (PT_R_REFINE == 1)
+void RPeakRefine(int16_t BeatDelay);
+#endif
+#if (PT_TEMPLATE == 1)
+void TemplateUpdate(void);
+int32_t TemplateDot(const int16_t *a, const int16_t *b);
+#endif
+#if (PT_SQI == 1 || PT_GAP == 1)
+void DecisionRestart(int16_t keep_rr);
+#endif
+#if (PT_GAP == 1)
+void PT_Gap(int32_t n);
+void GapPrime(pt_sample_t x);
+#endif
+#if (PT_EDR == 1)
+void EDRUpdate(int16_t rr, pt_sample_t amp);
+void EDRPoint(pt_sample_t amp);
+#endif
+#if (PT_MULTILEAD == 1)
+int16_t PT_StateMachineLeads(const pt_sample_t *datum);
+void LeadQuality(void);
+void LeadWeights(void);
+#endif
+#if (PT_QRS_WIDTH == 1)
+void QRSEdge(pt_level_t PEAKI);
+void QRSEmit(int16_t src);
+#endif
+#if (PT_SNAPSHOT == 1)
+uint32_t PT_Snapshot(void *buf);
+int16_t PT_Restore(const void *buf);
+int32_t PT_Seek(const void *snaps, int32_t count, uint32_t clock);
+uint32_t SnapCopy(uint8_t *buf, int16_t save);
+#endif
 
 /**********************************************************************
 	Debuggin Functions
 ***********************************************************************/
-int16_t PT_get_LPFilter_output(void);
-int16_t PT_get_HPFilter_output(void);
-int16_t PT_get_DRFilter_output(void);
-uint16_t PT_get_MVFilter_output(void);
-uint16_t PT_get_SQRFilter_output(void);
+pt_sample_t PT_get_LPFilter_output(void);
+pt_sample_t PT_get_HPFilter_output(void);
+pt_sample_t PT_get_DRFilter_output(void);
+pt_level_t PT_get_MVFilter_output(void);
+pt_level_t PT_get_SQRFilter_output(void);
 int16_t PT_get_ShortTimeHR_output(int16_t Fs);
 int16_t PT_get_LongTimeHR_output(int16_t Fs);
-uint16_t PT_get_ThI1_output(void);
-int16_t PT_get_ThF1_output(void);
-uint16_t PT_get_SKPI_output(void);
-uint16_t PT_get_NPKI_output(void);
-int16_t PT_get_SPKF_output(void);
-int16_t PT_get_NPKF_output(void);
+pt_level_t PT_get_ThI1_output(void);
+pt_sample_t PT_get_ThF1_output(void);
+pt_level_t PT_get_SKPI_output(void);
+pt_level_t PT_get_NPKI_output(void);
+pt_sample_t PT_get_SPKF_output(void);
+pt_sample_t PT_get_NPKF_output(void);
 int16_t PT_get_HRState_output(void);
+uint32_t PT_get_SampleClock_output(void);
+uint16_t PT_RR_to_HR(int16_t rr);
+uint16_t PT_get_ShortTimeHRQ_output(void);
+uint16_t PT_get_LongTimeHRQ_output(void);
+int16_t PT_get_Delay_output(void);
+#if (PT_HRV == 1)
+void PT_get_HRV_output(struct PT_hrv_stats *stats);
+void PT_get_RunningHRV_output(struct PT_hrv_stats *stats);
+#endif
+#if (PT_LFHF == 1)
+void PT_get_LFHF_output(struct PT_lfhf_stats *stats);
+#endif
+#if (PT_HRSTAT == 1)
+void PT_get_HRStats_output(int16_t win, struct PT_hrstat_stats *stats);
+uint16_t PT_get_HRPercentile_output(int16_t win, int16_t pct);
+#endif
+#if (PT_TREND == 1)
+int16_t PT_get_TrendBucket_output(int16_t level, uint16_t age, struct PT_trend_summary *summary);
+void PT_get_TrendSummary_output(uint32_t seconds, struct PT_trend_summary *summary);
+#endif
+#if (PT_ALARM == 1)
+void PT_set_AlarmConfig(const struct PT_alarm_config *config);
+int16_t PT_get_AlarmState_output(void);
+int16_t PT_get_AlarmEvent_output(struct PT_alarm_event *event);
+#endif
+#if (PT_SQI == 1)
+int16_t PT_get_LeadStatus_output(void);
+uint16_t PT_get_SQI_output(void);
+#endif
+#if (PT_CLIP_STATS == 1)
+void PT_get_ClipStats_output(struct PT_clip_stats *stats);
+void PT_clear_ClipStats(void);
+#endif
+#if (PT_AGC == 1)
+int16_t PT_get_AGCShift_output(void);
+#endif
+#if (PT_STAGE_OPS == 1)
+void PT_set_StageOps(const struct PT_stage_ops *ops);
+#endif
+#if (PT_PREPROC == 1)
+void PT_set_Preprocess(int16_t mode);
+int16_t PT_get_Preprocess_output(void);
+#endif
+#if (PT_R_REFINE == 1)
+int32_t PT_get_RPeakDelayQ_output(void);
+#endif
+#if (PT_TEMPLATE == 1)
+int16_t PT_get_BeatClass_output(void);
+int16_t PT_get_BeatCluster_output(void);
+int16_t PT_get_BeatCorr_output(void);
+#endif
+#if (PT_EDR == 1)
+int16_t PT_get_EDR_output(pt_sample_t *val);
+uint16_t PT_get_RespRate_output(void);
+#endif
+#if (PT_MULTILEAD == 1)
+void PT_set_LeadWeight(int16_t lead, int16_t weight);
+int16_t PT_get_LeadWeight_output(int16_t lead);
+#endif
+#if (PT_QRS_WIDTH == 1)
+int16_t PT_get_QRSOnset_output(void);
+int16_t PT_get_QRSOffset_output(void);
+int16_t PT_get_QRSWidth_output(void);
+#endif
+#if (PT_SNAPSHOT == 1)
+uint32_t PT_get_SnapshotSize_output(void);
+#endif
+#if (PT_LOW_LATENCY == 1)
+int16_t PT_get_BeatEvent_output(void);
+int16_t PT_get_ProvisionalDelay_output(void);
+#endif
 
 #endif
 
@@ -0,0 +1,444 @@
+/**********************************************************************************
+	PanTompkinsBeatDB.c
+
+	-------------------------------------------
+	-------------------------------------------
+	Description:
+
+	Beat store for many recordings: "all beats of channel X between t1 and t2".
+	The beats of the detector (or of beat files) are appended to per-channel
+	blocks of a memory-mapped file, with a time index per channel. One writer
+	appends while any number of readers, in the same or other processes, map
+	the file and query it without locks. A query returns spans of beats that
+	point directly into the mapping, no beat is copied. See PanTompkinsBeatDB.h
+	for the layout.
+
+	Dependencies :
+				- PanTompkinsBeatDB.h
+				- PanTompkinsBeatFile.h (beat flags)
+
+**********************************************************************************/
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE		200809L						// ftruncate, msync with -std=c11
+#endif
+
+#include <string.h>
+#include "PanTompkinsBeatDB.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#define DB_RELEASE()		MemoryBarrier()
+#define DB_ACQUIRE()		MemoryBarrier()
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define DB_RELEASE()		__atomic_thread_fence(__ATOMIC_RELEASE)
+#define DB_ACQUIRE()		__atomic_thread_fence(__ATOMIC_ACQUIRE)
+#endif
+
+#define DB_HEAD(db)			((struct PT_db_head *) (db)->Base)
+#define DB_TABLE(db)		((struct PT_db_slot *) ((db)->Base + DB_BLOCK_SIZE))
+#define DB_BLOCK(db, b)		((struct PT_db_block *) ((db)->Base + (size_t) (b) * DB_BLOCK_SIZE))
+
+typedef char DB_block_fits[(sizeof(struct PT_db_block) == DB_BLOCK_SIZE) ? 1 : -1];
+typedef char DB_slot_fits[(sizeof(struct PT_db_slot) == 16) ? 1 : -1];
+
+static int16_t DBMap(struct PT_beat_db *db, const char *name, uint32_t capacity, int16_t create);
+static struct PT_db_slot *DBSlot(const struct PT_beat_db *db, uint32_t channel, int16_t claim);
+static uint32_t DBNewBlock(struct PT_beat_db *db, struct PT_db_slot *slot, uint32_t channel, int64_t time);
+static uint32_t DBFind(const struct PT_beat_db *db, uint32_t last, int64_t time);
+static uint32_t DBLowerBound(const struct PT_db_block *block, uint32_t count, int64_t time);
+
+
+/**********************************************************************************
+
+Fuction Name: PT_DBCreate
+
+Parameter:
+Input	:	db			- Database.
+			name		- File to create, replaced if it exists.
+			capacity	- Size of the file in blocks of DB_BLOCK_SIZE bytes (about
+						  254 beats each), at least DB_FIRST_BLOCK + 1.
+
+Returns	:	0 if created, -1 otherwise.
+
+Description: Creates the file at its full size and maps it for writing. The size
+never changes, a full database is closed and a new one started (e.g. per month).
+
+**********************************************************************************/
+int16_t PT_DBCreate(struct PT_beat_db *db, const char *name, uint32_t capacity)
+{
+	struct PT_db_head *head;
+
+	memset(db, 0, sizeof(*db));
+	if (capacity <= DB_FIRST_BLOCK)
+		return (-1);
+	db->Writable = 1;
+	if (DBMap(db, name, capacity, 1) != 0)
+		return (-1);
+
+	// ---- New file reads as zeros: channel table empty ---- //
+	head = DB_HEAD(db);
+	head->Magic = DB_MAGIC;
+	head->Version = DB_VERSION;
+	head->Block_Size = DB_BLOCK_SIZE;
+	head->Capacity = capacity;
+	head->Channels = 0;
+	DB_RELEASE();
+	head->Published = DB_FIRST_BLOCK;
+
+	return (0);
+}
+
+
+/**********************************************************************************
+
+Fuction Name: PT_DBOpen
+
+Parameter:
+Input	:	db			- Database.
+			name		- File created by PT_DBCreate.
+			writable	- 1 for the writer (one at a time), 0 for a reader.
+
+Returns	:	0 if opened, -1 if the file is missing or not a beat database.
+
+**********************************************************************************/
+int16_t PT_DBOpen(struct PT_beat_db *db, const char *name, int16_t writable)
+{
+	struct PT_db_head *head;
+
+	memset(db, 0, sizeof(*db));
+	db->Writable = writable;
+	if (DBMap(db, name, 0, 0) != 0)
+		return (-1);
+
+	head = DB_HEAD(db);
+	if (db->Capacity <= DB_FIRST_BLOCK || head->Magic != DB_MAGIC || head->Version != DB_VERSION ||
+		head->Block_Size != DB_BLOCK_SIZE || head->Capacity != db->Capacity) {
+		PT_DBClose(db);
+		return (-1);
+	}
+
+	return (0);
+}
+
+
+// ------Flushes the writes of a writer and unmaps the file ------ //
+void PT_DBClose(struct PT_beat_db *db) {
+	if (db->Base == NULL)
+		return;
+#ifdef _WIN32
+	if (db->Writable)
+		FlushViewOfFile(db->Base, 0);
+	UnmapViewOfFile(db->Base);
+	CloseHandle((HANDLE) db->Map);
+	CloseHandle((HANDLE) db->File);
+#else
+	if (db->Writable)
+		msync(db->Base, (size_t) db->Capacity * DB_BLOCK_SIZE, MS_SYNC);
+	munmap(db->Base, (size_t) db->Capacity * DB_BLOCK_SIZE);
+	close((int) db->File);
+#endif
+	db->Base = NULL;
+}
+
+
+/**********************************************************************************
+
+Fuction Name: PT_DBAppend
+
+Parameter:
+Input	:	db			- Database opened for writing.
+			channel		- Channel of the beat, e.g. patient, recording and lead.
+			beat		- Beat, times strictly ascending for each channel.
+
+Returns	:	0 if appended, -1 if not after the last beat of the channel, or the
+			database or channel table is full.
+
+Description: Writes the beat into the last block of the channel, or into a new
+block (DBNewBlock) when that one is full. The beat is written before the count
+of the block is raised, so readers never see a partial beat.
+
+**********************************************************************************/
+int16_t PT_DBAppend(struct PT_beat_db *db, uint32_t channel, const struct PT_db_beat *beat)
+{
+	struct PT_db_slot *slot;
+	struct PT_db_block *block = NULL;
+	uint32_t b, count = 0;
+
+	if (!db->Writable || (slot = DBSlot(db, channel, 1)) == NULL)
+		return (-1);
+
+	if ((b = slot->Last) != 0) {
+		block = DB_BLOCK(db, b);
+		count = block->Count;
+		if (count && beat->Time <= block->Beat[count - 1].Time)
+			return (-1);
+	}
+
+	if (b == 0 || count == DB_BEATS) {
+		if ((b = DBNewBlock(db, slot, channel, beat->Time)) == 0)
+			return (-1);
+		block = DB_BLOCK(db, b);
+		count = 0;
+	}
+
+	block->Beat[count] = *beat;
+	DB_RELEASE();
+	block->Count = count + 1;
+
+	return (0);
+}
+
+
+/**********************************************************************************
+
+Fuction Name: PT_DBQuery
+
+Parameter:
+Input	:	db			- Database, opened by a reader or the writer.
+			channel		- Channel.
+			t1, t2		- Time range, beats with t1 <= Time < t2.
+			spans		- Receives the beats, one span per block in time order.
+			max_spans	- Size of spans.
+
+Returns	:	Number of spans written. When it is max_spans, the query goes on with t1
+			after the last beat of the last span.
+
+Description: Finds the block of t1 with the time index (DBFind) and follows the
+blocks of the channel while they start before t2, the first and last block are
+cut with a binary search. The spans point into the mapping and stay valid until
+PT_DBClose. Beats appended during the query are returned or not, but never torn.
+Next is loaded before Count: a block is linked only once full, so the count of a
+block the query goes past is final and no beat of it is skipped.
+
+**********************************************************************************/
+int32_t PT_DBQuery(const struct PT_beat_db *db, uint32_t channel, int64_t t1, int64_t t2, struct PT_db_span *spans, int32_t max_spans)
+{
+	const struct PT_db_slot *slot;
+	const struct PT_db_block *block;
+	uint32_t b, next, count, lo, hi;
+	int32_t n = 0;
+
+	if (t1 >= t2 || (slot = DBSlot(db, channel, 0)) == NULL)
+		return (0);
+
+	b = slot->Last;
+	DB_ACQUIRE();
+	b = DBFind(db, b, t1);
+	if (b == 0)
+		b = slot->First;
+
+	while (b != 0 && n < max_spans) {
+		block = DB_BLOCK(db, b);
+		next = block->Next;									// Before Count, a linked block is full
+		DB_ACQUIRE();
+		count = block->Count;
+		DB_ACQUIRE();
+		if (block->First_Time >= t2)
+			break;
+
+		lo = DBLowerBound(block, count, t1);
+		hi = DBLowerBound(block, count, t2);
+		if (hi > lo) {
+			spans[n].Beat = block->Beat + lo;
+			spans[n].Count = hi - lo;
+			++n;
+		}
+		if (hi < count)
+			break;
+
+		b = next;
+	}
+
+	return (n);
+}
+
+
+/**********************************************************************************
+	Helper functions
+**********************************************************************************/
+
+/************************************
+Maps the file, created at capacity blocks
+or opened at its size.
+*************************************/
+static int16_t DBMap(struct PT_beat_db *db, const char *name, uint32_t capacity, int16_t create) {
+#ifdef _WIN32
+	HANDLE file, map;
+	LARGE_INTEGER size;
+
+	file = CreateFileA(name, db->Writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+		FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, create ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return (-1);
+
+	if (create)
+		size.QuadPart = (LONGLONG) capacity * DB_BLOCK_SIZE;
+	else if (!GetFileSizeEx(file, &size)) {
+		CloseHandle(file);
+		return (-1);
+	}
+	db->Capacity = (uint32_t) (size.QuadPart / DB_BLOCK_SIZE);
+
+	map = CreateFileMappingA(file, NULL, db->Writable ? PAGE_READWRITE : PAGE_READONLY,
+		(DWORD) (size.QuadPart >> 32), (DWORD) size.QuadPart, NULL);							// Extends a new file
+	if (map == NULL) {
+		CloseHandle(file);
+		return (-1);
+	}
+	db->Base = (uint8_t *) MapViewOfFile(map, db->Writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0);
+	if (db->Base == NULL) {
+		CloseHandle(map);
+		CloseHandle(file);
+		return (-1);
+	}
+	db->File = (intptr_t) file;
+	db->Map = (intptr_t) map;
+#else
+	int fd;
+	struct stat st;
+	void *base;
+
+	fd = open(name, create ? O_RDWR | O_CREAT | O_TRUNC : (db->Writable ? O_RDWR : O_RDONLY), 0644);
+	if (fd < 0)
+		return (-1);
+
+	if (create && ftruncate(fd, (off_t) capacity * DB_BLOCK_SIZE) != 0) {
+		close(fd);
+		return (-1);
+	}
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return (-1);
+	}
+	db->Capacity = (uint32_t) (st.st_size / DB_BLOCK_SIZE);
+
+	base = mmap(NULL, (size_t) db->Capacity * DB_BLOCK_SIZE, db->Writable ? PROT_READ | PROT_WRITE : PROT_READ,
+		MAP_SHARED, fd, 0);
+	if (db->Capacity == 0 || base == MAP_FAILED) {
+		close(fd);
+		return (-1);
+	}
+	db->Base = (uint8_t *) base;
+	db->File = (intptr_t) fd;
+#endif
+
+	return (0);
+}
+
+/************************************
+Slot of a channel in the hash table (linear
+probing), NULL if not found. claim takes a
+free slot for a new channel, it is published
+with its first block.
+*************************************/
+static struct PT_db_slot *DBSlot(const struct PT_beat_db *db, uint32_t channel, int16_t claim) {
+	struct PT_db_slot *slot;
+	uint32_t h = ((channel * 2654435761u) >> 16) & (DB_CHANNELS - 1), idex;
+
+	for (idex = 0; idex < DB_CHANNELS; idex++) {
+		slot = DB_TABLE(db) + ((h + idex) & (DB_CHANNELS - 1));
+		if (slot->Last == 0) {
+			if (!claim)
+				return (NULL);
+			slot->Channel = channel;
+			return (slot);
+		}
+		DB_ACQUIRE();
+		if (slot->Channel == channel)
+			return (slot);
+	}
+	return (NULL);
+}
+
+/************************************
+Publishes a new block at the end of a
+channel, returns 0 if the database is full.
+The block is complete before the published
+count, the link from the previous block and
+the channel slot make it visible.
+*************************************/
+static uint32_t DBNewBlock(struct PT_beat_db *db, struct PT_db_slot *slot, uint32_t channel, int64_t time) {
+	struct PT_db_head *head = DB_HEAD(db);
+	struct PT_db_block *block, *prev, *jump;
+	uint32_t b = head->Published;
+
+	if (b >= db->Capacity)
+		return (0);
+
+	block = DB_BLOCK(db, b);
+	block->Channel = channel;
+	block->Count = 0;
+	block->Next = 0;
+	block->First_Time = time;
+	block->Prev = slot->Last;
+
+	// ---- Skew-binary jump: over two equal jumps of the previous block, or to it ---- //
+	if (block->Prev) {
+		prev = DB_BLOCK(db, block->Prev);
+		jump = DB_BLOCK(db, prev->Jump);
+		block->Depth = prev->Depth + 1;
+		if (prev->Depth - jump->Depth == jump->Depth - DB_BLOCK(db, jump->Jump)->Depth)
+			block->Jump = jump->Jump;
+		else
+			block->Jump = block->Prev;
+	}
+	else {
+		block->Depth = 0;
+		block->Jump = b;
+	}
+
+	DB_RELEASE();
+	head->Published = b + 1;
+	if (block->Prev)
+		DB_BLOCK(db, block->Prev)->Next = b;
+	else {
+		slot->First = b;
+		++head->Channels;
+	}
+	++slot->Blocks;
+	DB_RELEASE();
+	slot->Last = b;
+
+	return (b);
+}
+
+/************************************
+Last block of the chain ending at last
+that starts at or before time, 0 if none.
+Jumps while the jump target still starts
+after time, O(log n) blocks.
+*************************************/
+static uint32_t DBFind(const struct PT_beat_db *db, uint32_t last, int64_t time) {
+	const struct PT_db_block *block;
+	uint32_t b = last;
+
+	while (b != 0) {
+		block = DB_BLOCK(db, b);
+		if (block->First_Time <= time)
+			break;
+		if (block->Jump != b && DB_BLOCK(db, block->Jump)->First_Time > time)
+			b = block->Jump;
+		else
+			b = block->Prev;
+	}
+	return (b);
+}
+
+// ------Index of the first of count beats with Time >= time ------ //
+static uint32_t DBLowerBound(const struct PT_db_block *block, uint32_t count, int64_t time) {
+	uint32_t lo = 0, hi = count, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) >> 1;
+		if (block->Beat[mid].Time < time)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (lo);
+}
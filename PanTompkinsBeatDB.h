@@ -0,0 +1,97 @@
+#ifndef _PANTOMPKINS_BEATDB_H_
+#define _PANTOMPKINS_BEATDB_H_
+
+#include <stdint.h>
+#include "PanTompkinsBeatFile.h"
+
+/************************************************************
+    Beat database layout (native byte order, one writer)
+
+    Block 0			Head: DB_MAGIC, version, block size, capacity, published blocks
+    Blocks 1 to DB_TABLE_BLOCKS
+					Channel table, DB_CHANNELS slots hashed on the channel id
+    Other blocks	Beat blocks of one channel each: head, then up to DB_BEATS
+					beats in ascending time
+
+    The file has a fixed capacity, the mapping never moves, so the spans
+    returned by PT_DBQuery stay valid while the writer appends. A block,
+    a channel slot or a beat is written before the count that makes it
+    visible (release), readers load the counts first (acquire).
+
+    Time index: the blocks of a channel are linked in time order (Next)
+    and back with skew-binary jump pointers (Myers), the block holding a
+    time is found in O(log n) steps from the last block of the channel.
+ ************************************************************/
+#define DB_MAGIC			((uint32_t)	(0x42445450))	// "PTDB"
+#define DB_VERSION			((uint32_t)	(1))
+#define DB_BLOCK_SIZE		4096						// Bytes of a block, one page
+#define DB_CHANNELS			4096						// Channel slots (power of 2), e.g. recordings x leads
+#define DB_TABLE_BLOCKS		((DB_CHANNELS * 16) / DB_BLOCK_SIZE)
+#define DB_FIRST_BLOCK		(1 + DB_TABLE_BLOCKS)		// First beat block
+#define DB_BEATS			((DB_BLOCK_SIZE - 32) / 16)	// Beats of a block, 254
+
+/************************************************************
+    Records of the mapping
+ ************************************************************/
+struct PT_db_beat
+{
+	int64_t Time;								//  Time of the R peak, e.g. msec since the epoch
+	int32_t RR;									//  RR interval in the same unit, 0 if unknown
+	uint32_t Flags;								//  BF_SEARCHBACK, BF_IRREGULAR, BF_PROVISIONAL
+};
+
+struct PT_db_head
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t Block_Size;
+	uint32_t Capacity;							//  Blocks of the file, head and channel table included
+	volatile uint32_t Published;				//  Blocks in use
+	uint32_t Channels;							//  Channels in the table
+};
+
+struct PT_db_slot
+{
+	uint32_t Channel;							//  Channel id
+	uint32_t First;								//  First block of the channel
+	volatile uint32_t Last;						//  Last block of the channel, 0 if the slot is free
+	uint32_t Blocks;							//  Blocks of the channel
+};
+
+struct PT_db_block
+{
+	uint32_t Channel;
+	volatile uint32_t Count;					//  Beats of the block
+	uint32_t Prev;								//  Previous block of the channel, 0 if none
+	volatile uint32_t Next;						//  Next block of the channel, 0 if none yet
+	uint32_t Jump;								//  Skew-binary jump pointer, 0 if none
+	uint32_t Depth;								//  Blocks of the channel before this one
+	int64_t First_Time;							//  Time of the first beat
+	struct PT_db_beat Beat[DB_BEATS];
+};
+
+struct PT_db_span								// Beats returned by PT_DBQuery, inside the mapping
+{
+	const struct PT_db_beat *Beat;
+	uint32_t Count;
+};
+
+struct PT_beat_db
+{
+	uint8_t *Base;								//  Mapping of the file
+	uint32_t Capacity;
+	int16_t Writable;
+	intptr_t File;								//  File handle or descriptor
+	intptr_t Map;								//  File mapping handle (Windows)
+};
+
+/**********************************************************************
+    Function Prototypes
+ **********************************************************************/
+int16_t PT_DBCreate(struct PT_beat_db *db, const char *name, uint32_t capacity);
+int16_t PT_DBOpen(struct PT_beat_db *db, const char *name, int16_t writable);
+void PT_DBClose(struct PT_beat_db *db);
+int16_t PT_DBAppend(struct PT_beat_db *db, uint32_t channel, const struct PT_db_beat *beat);
+int32_t PT_DBQuery(const struct PT_beat_db *db, uint32_t channel, int64_t t1, int64_t t2, struct PT_db_span *spans, int32_t max_spans);
+
+#endif
@@ -0,0 +1,591 @@
+/**********************************************************************************
+	PanTompkinsBeatFile.c
+
+	-------------------------------------------
+	-------------------------------------------
+	Description:
+
+	Compact binary beat annotations, an alternative to the RBeat column of the
+	per-sample csv of PanTompkinsCMD. Each beat takes about 3 bytes: the sample
+	index and the RR interval are delta encoded as varints, and the beat flags
+	(search-back, irregular, provisional) share the varint of the sample index.
+	Beats are grouped in fixed-size blocks that decode on their own, a block index
+	at the end of the file lets a viewer jump to any hour of a recording and
+	decode a single block. See PanTompkinsBeatFile.h for the layout.
+
+	Dependencies :
+				- PanTompkinsBeatFile.h
+
+**********************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "PanTompkinsBeatFile.h"
+
+static int16_t BeatFlush(struct PT_beat_writer *w);
+static int16_t BeatLoad(struct PT_beat_reader *r, uint32_t block);
+static uint16_t PutVarint(uint8_t *buf, uint32_t val);
+static uint16_t GetVarint(const uint8_t *buf, uint16_t len, uint32_t *val);
+static void Put16(uint8_t *buf, uint16_t val);
+static uint16_t Get16(const uint8_t *buf);
+static void Put32(uint8_t *buf, uint32_t val);
+static uint32_t Get32(const uint8_t *buf);
+
+
+/**********************************************************************************
+
+Fuction Name: PT_BeatWriterOpen
+
+Parameter:
+Input	:	w		- Writer.
+			name	- File to create.
+			fs		- Sampling rate of the sample indices.
+
+Returns	:	0 if the file was created, -1 otherwise.
+
+Description: Creates the file and writes its head. Beats are then appended with
+PT_BeatWrite, the file is complete after PT_BeatWriterClose.
+
+**********************************************************************************/
+int16_t PT_BeatWriterOpen(struct PT_beat_writer *w, const char *name, uint16_t fs)
+{
+	uint8_t head[BF_HEAD_SIZE];
+
+	memset(w, 0, sizeof(*w));
+	if (fopen_s(&w->File, name, "wb") != 0)
+		return (-1);
+
+	memset(head, 0, sizeof(head));
+	Put32(head, BF_MAGIC);
+	Put16(head + 4, BF_VERSION);
+	Put16(head + 6, fs);
+	Put16(head + 8, BF_BLOCK_SIZE);
+	Put16(head + 10, BF_BLOCK_HEAD);
+	w->Used = BF_BLOCK_HEAD;
+
+	return ((fwrite(head, sizeof(head), 1, w->File) == 1) ? 0 : -1);
+}
+
+
+/**********************************************************************************
+
+Fuction Name: PT_BeatWrite
+
+Parameter:
+Input	:	w		- Writer.
+			beat	- Next beat, samples in ascending order.
+
+Returns	:	0 if written, -1 if out of order or on a write error.
+
+Description: Encodes the beat into the current block. A full block is written to
+the file (BeatFlush) and the beat starts the next one, with its sample index and
+the previous RR in the block head.
+
+**********************************************************************************/
+int16_t PT_BeatWrite(struct PT_beat_writer *w, const struct PT_beat *beat)
+{
+	uint8_t buf[BF_BEAT_MAX];
+	uint32_t delta, zz;
+	uint16_t n = 0;
+
+	if ((w->Count || w->Blocks) && beat->Sample < w->Last_Sample)
+		return (-1);
+
+	zz = ((uint32_t) (beat->RR - w->Last_RR) << 1) ^ (uint32_t) ((beat->RR - w->Last_RR) >> 31);
+
+	if (w->Count) {
+		delta = beat->Sample - w->Last_Sample;
+		if ((delta >> (32 - BF_FLAG_BITS)) == 0) {
+			n = PutVarint(buf, (delta << BF_FLAG_BITS) | (beat->Flags & ((1 << BF_FLAG_BITS) - 1)));
+			n += PutVarint(buf + n, zz);
+		}
+		// ---- Block full, or a delta too long for the varint ---- //
+		if (n == 0 || w->Used + n > BF_BLOCK_SIZE)
+			if (BeatFlush(w) != 0)
+				return (-1);
+	}
+
+	// ---- First beat of a block, delta 0 to the head ---- //
+	if (w->Count == 0) {
+		Put32(w->Block, beat->Sample);
+		Put32(w->Block + 4, (uint32_t) w->Last_RR);
+		n = PutVarint(buf, beat->Flags & ((1 << BF_FLAG_BITS) - 1));
+		n += PutVarint(buf + n, zz);
+	}
+
+	memcpy(w->Block + w->Used, buf, n);
+	w->Used += n;
+	++w->Count;
+	w->Last_Sample = beat->Sample;
+	w->Last_RR = beat->RR;
+
+	return (0);
+}
+
+
+/**********************************************************************************
+
+Fuction Name: PT_BeatWriterClose
+
+Parameter:
+Input	:	w		- Writer.
+
+Returns	:	0 if the file is complete, -1 on a write error.
+
+Description: Writes the last block, the block index and the tail, and closes the file.
+
+**********************************************************************************/
+int16_t PT_BeatWriterClose(struct PT_beat_writer *w)
+{
+	uint8_t buf[4];
+	uint32_t idex;
+	int16_t err = 0;
+
+	if (w->Count && BeatFlush(w) != 0)
+		err = -1;
+
+	for (idex = 0; idex < w->Blocks && !err; idex++) {
+		Put32(buf, w->Index[idex]);
+		if (fwrite(buf, sizeof(buf), 1, w->File) != 1)
+			err = -1;
+	}
+	Put32(buf, w->Blocks);
+	if (!err && fwrite(buf, sizeof(buf), 1, w->File) != 1)
+		err = -1;
+	Put32(buf, BF_INDEX_MAGIC);
+	if (!err && fwrite(buf, sizeof(buf), 1, w->File) != 1)
+		err = -1;
+
+	if (fclose(w->File) != 0)
+		err = -1;
+	free(w->Index);
+	w->Index = NULL;
+
+	return (err);
+}
+
+
+/**********************************************************************************
+
+Fuction Name: PT_BeatWriterMark
+
+Parameter:
+Input	:	w		- Writer.
+
+Output	:	m		- Writer state.
+
+Returns	:	0 if the written blocks reached the disk, -1 otherwise.
+
+Description: Saves the state of the writer, the number of blocks in the file and the
+block being filled, so that PT_BeatWriterReopen continues the file from this point
+with the same bytes (e.g. a run resumed from a checkpoint).
+
+**********************************************************************************/
+int16_t PT_BeatWriterMark(struct PT_beat_writer *w, struct PT_beat_mark *m)
+{
+	memset(m, 0, sizeof(*m));
+	m->Blocks = w->Blocks;
+	m->Used = w->Used;
+	m->Count = w->Count;
+	m->Last_Sample = w->Last_Sample;
+	m->Last_RR = w->Last_RR;
+	memcpy(m->Block, w->Block, w->Used);
+
+	return ((fflush(w->File) == 0) ? 0 : -1);
+}
+
+
+/**********************************************************************************
+
+Fuction Name: PT_BeatWriterReopen
+
+Parameter:
+Input	:	w		- Writer.
+			name	- Beat file written up to the mark.
+			m		- Writer state from PT_BeatWriterMark.
+
+Returns	:	0 if reopened, -1 if the file is missing, not a beat file or shorter
+			than the mark.
+
+Description: Reopens the file for writing after the blocks of the mark, the block
+index is read back from the block heads. Blocks, index and tail written after the
+mark are written again.
+
+**********************************************************************************/
+int16_t PT_BeatWriterReopen(struct PT_beat_writer *w, const char *name, const struct PT_beat_mark *m)
+{
+	uint8_t head[BF_HEAD_SIZE];
+	uint32_t idex;
+	int16_t err = 0;
+
+	memset(w, 0, sizeof(*w));
+	if (m->Used < BF_BLOCK_HEAD || m->Used > BF_BLOCK_SIZE || fopen_s(&w->File, name, "r+b") != 0)
+		return (-1);
+
+	if (fread(head, sizeof(head), 1, w->File) != 1 || Get32(head) != BF_MAGIC || Get16(head + 4) != BF_VERSION ||
+		Get16(head + 8) != BF_BLOCK_SIZE || Get16(head + 10) != BF_BLOCK_HEAD)
+		err = -1;
+
+	if (!err && m->Blocks) {
+		w->Index = (uint32_t *) malloc(m->Blocks * sizeof(uint32_t));
+		w->Index_Size = m->Blocks;
+		if (w->Index == NULL)
+			err = -1;
+	}
+	for (idex = 0; idex < m->Blocks && !err; idex++) {
+		if (fseek(w->File, BF_HEAD_SIZE + (long) idex * BF_BLOCK_SIZE, SEEK_SET) != 0 ||
+			fread(head, 4, 1, w->File) != 1)
+			err = -1;
+		else
+			w->Index[idex] = Get32(head);
+	}
+
+	if (err || fseek(w->File, BF_HEAD_SIZE + (long) m->Blocks * BF_BLOCK_SIZE, SEEK_SET) != 0) {
+		fclose(w->File);
+		free(w->Index);
+		memset(w, 0, sizeof(*w));
+		return (-1);
+	}
+
+	w->Blocks = m->Blocks;
+	memcpy(w->Block, m->Block, m->Used);
+	w->Used = m->Used;
+	w->Count = m->Count;
+	w->Last_Sample = m->Last_Sample;
+	w->Last_RR = m->Last_RR;
+
+	return (0);
+}
+
+
+/**********************************************************************************
+
+Fuction Name: PT_BeatReaderOpen
+
+Parameter:
+Input	:	r		- Reader.
+			name	- Beat file.
+
+Returns	:	0 if opened, -1 if the file is missing or not a beat file.
+
+Description: Loads the block index from the tail, or from the block heads when the
+writer was not closed (e.g. a crashed recording), and positions the reader on the
+first beat.
+
+**********************************************************************************/
+int16_t PT_BeatReaderOpen(struct PT_beat_reader *r, const char *name)
+{
+	uint8_t head[BF_HEAD_SIZE], block_head[BF_BLOCK_HEAD], buf[8];
+	uint32_t idex;
+	long size;
+	int16_t indexed = 0;
+
+	memset(r, 0, sizeof(*r));
+	if (fopen_s(&r->File, name, "rb") != 0)
+		return (-1);
+
+	if (fread(head, sizeof(head), 1, r->File) != 1 || Get32(head) != BF_MAGIC || Get16(head + 4) != BF_VERSION ||
+		Get16(head + 8) != BF_BLOCK_SIZE || Get16(head + 10) != BF_BLOCK_HEAD) {
+		fclose(r->File);
+		return (-1);
+	}
+	r->Fs = Get16(head + 6);
+
+	fseek(r->File, 0, SEEK_END);
+	size = ftell(r->File);
+
+	// ---- Closed file: index and tail after the blocks ---- //
+	if (size >= BF_HEAD_SIZE + 8 && fseek(r->File, size - 8, SEEK_SET) == 0 &&
+		fread(buf, sizeof(buf), 1, r->File) == 1 && Get32(buf + 4) == BF_INDEX_MAGIC) {
+		r->Blocks = Get32(buf);
+		indexed = (size == BF_HEAD_SIZE + (long) r->Blocks * (BF_BLOCK_SIZE + 4) + 8);
+	}
+	if (!indexed)
+		r->Blocks = (uint32_t) ((size - BF_HEAD_SIZE) / BF_BLOCK_SIZE);
+
+	r->Index = (uint32_t *) malloc((r->Blocks ? r->Blocks : 1) * sizeof(uint32_t));
+	if (r->Index == NULL) {
+		fclose(r->File);
+		return (-1);
+	}
+
+	for (idex = 0; idex < r->Blocks; idex++) {
+		if (indexed) {
+			fseek(r->File, BF_HEAD_SIZE + (long) r->Blocks * BF_BLOCK_SIZE + (long) idex * 4, SEEK_SET);
+			if (fread(block_head, 4, 1, r->File) != 1) {
+				PT_BeatReaderClose(r);
+				return (-1);
+			}
+		}
+		// ---- Without index, the blocks end at the first torn or invalid head ---- //
+		else if (fseek(r->File, BF_HEAD_SIZE + (long) idex * BF_BLOCK_SIZE, SEEK_SET) != 0 ||
+			fread(block_head, sizeof(block_head), 1, r->File) != 1 || Get16(block_head + 8) == 0 ||
+			Get16(block_head + 10) > BF_BLOCK_SIZE || (idex && Get32(block_head) < r->Index[idex - 1])) {
+			r->Blocks = idex;
+			break;
+		}
+		r->Index[idex] = Get32(block_head);
+	}
+
+	if (r->Blocks && BeatLoad(r, 0) != 0) {
+		PT_BeatReaderClose(r);
+		return (-1);
+	}
+
+	return (0);
+}
+
+
+/**********************************************************************************
+
+Fuction Name: PT_BeatSeek
+
+Parameter:
+Input	:	r		- Reader.
+			sample	- Sample index to jump to.
+
+Returns	:	1 if positioned on the first beat at or after sample, 0 if there is
+			none, -1 on a read error.
+
+Description: Finds the block of sample in the index (binary search) and decodes
+that block only, the next PT_BeatRead returns the beat found.
+
+**********************************************************************************/
+int16_t PT_BeatSeek(struct PT_beat_reader *r, uint32_t sample)
+{
+	struct PT_beat beat;
+	int32_t lo = 0, hi = (int32_t) r->Blocks - 1, mid, found = 0;
+	int16_t ret;
+
+	r->Has_Next = 0;
+	if (r->Blocks == 0)
+		return (0);
+
+	// ---- Last block starting at or before sample ---- //
+	while (lo <= hi) {
+		mid = lo + ((hi - lo) >> 1);
+		if (r->Index[mid] <= sample) {
+			found = mid;
+			lo = mid + 1;
+		}
+		else
+			hi = mid - 1;
+	}
+
+	if (BeatLoad(r, (uint32_t) found) != 0)
+		return (-1);
+
+	while ((ret = PT_BeatRead(r, &beat)) == 1) {
+		if (beat.Sample >= sample) {
+			r->Next = beat;
+			r->Has_Next = 1;
+			break;
+		}
+	}
+
+	return (ret);
+}
+
+
+/**********************************************************************************
+
+Fuction Name: PT_BeatRead
+
+Parameter:
+Input	:	r		- Reader.
+			beat	- Receives the next beat.
+
+Returns	:	1 if a beat was read, 0 at the end of the file, -1 on a read error or
+			a corrupted block.
+
+**********************************************************************************/
+int16_t PT_BeatRead(struct PT_beat_reader *r, struct PT_beat *beat)
+{
+	uint32_t val, zz;
+	uint16_t n;
+
+	if (r->Has_Next) {
+		*beat = r->Next;
+		r->Has_Next = 0;
+		return (1);
+	}
+
+	while (r->Left == 0) {
+		if (r->Cur + 1 >= r->Blocks)
+			return (0);
+		if (BeatLoad(r, r->Cur + 1) != 0)
+			return (-1);
+	}
+
+	n = GetVarint(r->Block + r->Pos, BF_BLOCK_SIZE - r->Pos, &val);
+	if (n == 0)
+		return (-1);
+	r->Pos += n;
+	n = GetVarint(r->Block + r->Pos, BF_BLOCK_SIZE - r->Pos, &zz);
+	if (n == 0)
+		return (-1);
+	r->Pos += n;
+	--r->Left;
+
+	r->Last_Sample += val >> BF_FLAG_BITS;
+	r->Last_RR += (int32_t) (zz >> 1) ^ -(int32_t) (zz & 1);
+	beat->Sample = r->Last_Sample;
+	beat->RR = r->Last_RR;
+	beat->Flags = (uint8_t) (val & ((1 << BF_FLAG_BITS) - 1));
+
+	return (1);
+}
+
+
+// ------Closes the file of a reader ------ //
+void PT_BeatReaderClose(struct PT_beat_reader *r) {
+	fclose(r->File);
+	free(r->Index);
+	r->Index = NULL;
+}
+
+
+/**********************************************************************************
+
+Fuction Name: PT_BeatFileFromCSV
+
+Parameter:
+Input	:	csv_name	- output.csv of PanTompkinsCMD.
+			name		- Beat file to create.
+			fs			- Sampling rate of the record.
+
+Returns	:	Number of beats converted, -1 if a file could not be opened or written.
+
+Description: Converter from the per-sample csv: each non-zero RBeat (7th column)
+is a beat, the RR is the distance to the previous one (0 for the first). The csv
+has no flags, the beats are written without.
+
+**********************************************************************************/
+int32_t PT_BeatFileFromCSV(const char *csv_name, const char *name, uint16_t fs)
+{
+	struct PT_beat_writer w;
+	struct PT_beat beat;
+	FILE *fptr;
+	char line[256], *p;
+	long rloc;
+	uint32_t prev = 0;
+	int32_t count = 0;
+	int16_t col;
+
+	if (fopen_s(&fptr, csv_name, "r") != 0)
+		return (-1);
+	if (PT_BeatWriterOpen(&w, name, fs) != 0) {
+		fclose(fptr);
+		return (-1);
+	}
+
+	// ---- Skip the header ---- //
+	if (fgets(line, sizeof(line), fptr) == NULL)
+		line[0] = '\0';
+
+	while (fgets(line, sizeof(line), fptr) != NULL) {
+		for (p = line, col = 0; col < 6 && p != NULL; col++) {
+			p = strchr(p, ',');
+			if (p != NULL)
+				++p;
+		}
+		if (p == NULL || (rloc = strtol(p, NULL, 10)) <= 0)
+			continue;
+
+		beat.Sample = (uint32_t) rloc;
+		beat.RR = count ? (int32_t) (beat.Sample - prev) : 0;
+		beat.Flags = 0;
+		if (PT_BeatWrite(&w, &beat) != 0)
+			break;
+		prev = beat.Sample;
+		++count;
+	}
+
+	fclose(fptr);
+	return ((PT_BeatWriterClose(&w) == 0) ? count : -1);
+}
+
+
+/**********************************************************************************
+	Helper functions
+**********************************************************************************/
+
+// ------Writes the current block to the file and adds it to the index ------ //
+static int16_t BeatFlush(struct PT_beat_writer *w) {
+	uint32_t *index;
+
+	if (w->Blocks == w->Index_Size) {
+		index = (uint32_t *) realloc(w->Index, (w->Index_Size ? 2 * w->Index_Size : 64) * sizeof(uint32_t));
+		if (index == NULL)
+			return (-1);
+		w->Index = index;
+		w->Index_Size = w->Index_Size ? 2 * w->Index_Size : 64;
+	}
+	w->Index[w->Blocks++] = Get32(w->Block);
+
+	Put16(w->Block + 8, w->Count);
+	Put16(w->Block + 10, w->Used);
+	memset(w->Block + w->Used, 0, BF_BLOCK_SIZE - w->Used);
+	w->Count = 0;
+	w->Used = BF_BLOCK_HEAD;
+
+	return ((fwrite(w->Block, BF_BLOCK_SIZE, 1, w->File) == 1) ? 0 : -1);
+}
+
+// ------Reads a block and starts decoding it ------ //
+static int16_t BeatLoad(struct PT_beat_reader *r, uint32_t block) {
+	if (fseek(r->File, BF_HEAD_SIZE + (long) block * BF_BLOCK_SIZE, SEEK_SET) != 0 ||
+		fread(r->Block, BF_BLOCK_SIZE, 1, r->File) != 1)
+		return (-1);
+
+	r->Cur = block;
+	r->Last_Sample = Get32(r->Block);
+	r->Last_RR = (int32_t) Get32(r->Block + 4);
+	r->Left = Get16(r->Block + 8);
+	r->Pos = BF_BLOCK_HEAD;
+
+	return ((Get16(r->Block + 10) <= BF_BLOCK_SIZE) ? 0 : -1);
+}
+
+// ------Unsigned LEB128 varint, returns the bytes written ------ //
+static uint16_t PutVarint(uint8_t *buf, uint32_t val) {
+	uint16_t n = 0;
+
+	while (val >= 0x80) {
+		buf[n++] = (uint8_t) (val | 0x80);
+		val >>= 7;
+	}
+	buf[n++] = (uint8_t) val;
+	return (n);
+}
+
+// ------Returns the bytes read, 0 if the varint is truncated or too long ------ //
+static uint16_t GetVarint(const uint8_t *buf, uint16_t len, uint32_t *val) {
+	uint16_t n = 0;
+
+	*val = 0;
+	while (n < len && n < 5) {
+		*val |= (uint32_t) (buf[n] & 0x7F) << (7 * n);
+		if (!(buf[n++] & 0x80))
+			return (n);
+	}
+	return (0);
+}
+
+static void Put16(uint8_t *buf, uint16_t val) {
+	buf[0] = (uint8_t) val;
+	buf[1] = (uint8_t) (val >> 8);
+}
+
+static uint16_t Get16(const uint8_t *buf) {
+	return ((uint16_t) (buf[0] | (buf[1] << 8)));
+}
+
+static void Put32(uint8_t *buf, uint32_t val) {
+	Put16(buf, (uint16_t) val);
+	Put16(buf + 2, (uint16_t) (val >> 16));
+}
+
+static uint32_t Get32(const uint8_t *buf) {
+	return ((uint32_t) Get16(buf) | ((uint32_t) Get16(buf + 2) << 16));
+}
@@ -0,0 +1,100 @@
+#ifndef _PANTOMPKINS_BEATFILE_H_
+#define _PANTOMPKINS_BEATFILE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+/************************************************************
+    Beat file layout (all fields little-endian)
+
+    File head		BF_HEAD_SIZE bytes: BF_MAGIC, version, sampling rate, block size
+    Blocks			BF_BLOCK_SIZE bytes each, zero padded:
+		Block head	BF_BLOCK_HEAD bytes: sample of the first beat, RR before
+					the block, beats in the block, payload bytes
+		Beats		varint((sample - previous sample) << BF_FLAG_BITS | flags),
+					zigzag varint(RR - previous RR)
+    Block index		First sample of each block (uint32)
+    Tail			Number of blocks, BF_INDEX_MAGIC
+
+    Blocks decode on their own, so a reader jumps to any time through
+    the index. A file without tail (writer not closed) is read through
+    the block heads.
+ ************************************************************/
+#define BF_MAGIC			((uint32_t)	(0x46425450))	// "PTBF"
+#define BF_INDEX_MAGIC		((uint32_t)	(0x49425450))	// "PTBI"
+#define BF_VERSION			((uint16_t)	(1))
+#define BF_HEAD_SIZE		16							// File head bytes
+#define BF_BLOCK_SIZE		512							// Block bytes, about 150 beats
+#define BF_BLOCK_HEAD		12							// Block head bytes
+#define BF_BEAT_MAX			10							// Longest encoded beat
+#define BF_FLAG_BITS		3
+
+// Beat flags
+#define BF_SEARCHBACK		1		// Found by the search-back
+#define BF_IRREGULAR		2		// Heart rate irregular at the beat (HR_State)
+#define BF_PROVISIONAL		4		// Reported early as a provisional beat (PT_LOW_LATENCY)
+
+/************************************************************
+    Beats, writer and reader
+ ************************************************************/
+struct PT_beat
+{
+	uint32_t Sample;							//  Sample index of the R peak
+	int32_t RR;									//  RR interval in samples, 0 if unknown
+	uint8_t Flags;								//  BF_SEARCHBACK, BF_IRREGULAR, BF_PROVISIONAL
+};
+
+struct PT_beat_writer
+{
+	FILE *File;
+	uint8_t Block[BF_BLOCK_SIZE];				//  Block being filled
+	uint16_t Used;								//  Bytes of Block, head included
+	uint16_t Count;								//  Beats in Block
+	uint32_t Last_Sample;						//  Last beat written
+	int32_t Last_RR;
+	uint32_t *Index;							//  First sample of each written block
+	uint32_t Blocks;
+	uint32_t Index_Size;
+};
+
+struct PT_beat_mark								// Writer state at a checkpoint, to reopen the file there
+{
+	uint32_t Blocks;							//  Blocks written to the file
+	uint16_t Used;
+	uint16_t Count;
+	uint32_t Last_Sample;
+	int32_t Last_RR;
+	uint8_t Block[BF_BLOCK_SIZE];				//  Block being filled
+};
+
+struct PT_beat_reader
+{
+	FILE *File;
+	uint16_t Fs;								//  Sampling rate of the file
+	uint32_t *Index;							//  First sample of each block
+	uint32_t Blocks;
+	uint32_t Cur;								//  Block in Block, Blocks if none
+	uint8_t Block[BF_BLOCK_SIZE];
+	uint16_t Pos;								//  Next byte of Block
+	uint16_t Left;								//  Beats left in Block
+	uint32_t Last_Sample;						//  Last decoded beat
+	int32_t Last_RR;
+	struct PT_beat Next;						//  Beat found by PT_BeatSeek
+	int16_t Has_Next;
+};
+
+/**********************************************************************
+    Function Prototypes
+ **********************************************************************/
+int16_t PT_BeatWriterOpen(struct PT_beat_writer *w, const char *name, uint16_t fs);
+int16_t PT_BeatWrite(struct PT_beat_writer *w, const struct PT_beat *beat);
+int16_t PT_BeatWriterClose(struct PT_beat_writer *w);
+int16_t PT_BeatWriterMark(struct PT_beat_writer *w, struct PT_beat_mark *m);
+int16_t PT_BeatWriterReopen(struct PT_beat_writer *w, const char *name, const struct PT_beat_mark *m);
+int16_t PT_BeatReaderOpen(struct PT_beat_reader *r, const char *name);
+int16_t PT_BeatSeek(struct PT_beat_reader *r, uint32_t sample);
+int16_t PT_BeatRead(struct PT_beat_reader *r, struct PT_beat *beat);
+void PT_BeatReaderClose(struct PT_beat_reader *r);
+int32_t PT_BeatFileFromCSV(const char *csv_name, const char *name, uint16_t fs);
+
+#endif
@@ -6,6 +6,8 @@ a csv file.
 Dependencies :
 				- PanTompkins.h
 				- PanTompkins.c
+				- PanTompkinsBeatFile.h, PanTompkinsBeatFile.c (PT_BEATFILE)
+				- PanTompkinsBeatDB.h, PanTompkinsBeatDB.c (PT_BEATDB)
 
 Hooman Sedghamiz, 
 
@@ -37,42 +39,190 @@ SOFTWARE.
 
 #include <stdio.h>
 #include <stdlib.h> // For exit() function
+#include <string.h> // For memset() function
+#include <time.h>	// For clock() function
 #include "PanTompkins.h"
+#if (PT_BEATFILE == 1)
+#include "PanTompkinsBeatFile.h"
+#endif
+#if (PT_BEATDB == 1)
+#include "PanTompkinsBeatDB.h"
+#define CMD_DB_BLOCKS	((uint32_t) 1024)			// output.db of 4 MB, about 250000 beats
+#endif
+
+#if (PT_SNAPSHOT == 1)
+// ------- Checkpoint sidecar: a head, then an entry and a detector snapshot every CHECKPOINT seconds ------- //
+#define CKPT_MAGIC		((uint32_t) 0x4B435450)		// "PTCK"
+
+struct ckpt_head
+{
+	uint32_t Magic;
+	uint32_t Fs;				// PT_FS of the run
+	uint32_t Seconds;			// Signal between two entries
+	uint32_t Snap_Size;			// PT_get_SnapshotSize_output() of the run
+	uint32_t Entry_Size;		// sizeof(struct ckpt_entry) of the run
+};
+
+struct ckpt_entry
+{
+	int64_t In_Pos;				// Input file position of the next sample
+	int64_t Out_Pos;			// output.csv position of the next row
+	int32_t SampleCount;		// Samples read before the entry
+	int32_t Rcount;				// Beats detected before the entry
+#if (PT_BEATFILE == 1 || PT_BEATDB == 1)
+	uint32_t PrevRLoc;			// Last beat written, for the RR of the next one
+#endif
+#if (PT_BEATFILE == 1)
+	struct PT_beat_mark Beats;	// output.beats writer, reopened where it was
+#endif
+};
+
+// ------- Appends an entry with the current detector state, the caller fills the counts ------- //
+static void CheckpointWrite(FILE *fptr_ckpt, FILE *fptr, FILE *fptr_out, uint8_t *snap, struct ckpt_entry *entry)
+{
+	uint32_t snap_size = PT_Snapshot(snap);
+
+	fflush(fptr_out);												// Rows before the entry reach the disk first
+	entry->In_Pos = (int64_t) ftell(fptr);
+	entry->Out_Pos = (int64_t) ftell(fptr_out);
+	fwrite(entry, sizeof(*entry), 1, fptr_ckpt);
+	fwrite(snap, snap_size, 1, fptr_ckpt);
+	fflush(fptr_ckpt);
+}
+
+// ------- Restores the last complete entry of a sidecar, returns 0 if there is none ------- //
+static int CheckpointResume(FILE *fptr_ckpt, int seconds, uint8_t *snap, struct ckpt_entry *entry)
+{
+	struct ckpt_head head;
+	uint32_t snap_size = PT_get_SnapshotSize_output();
+	long size, count;
+
+	if (fread(&head, sizeof(head), 1, fptr_ckpt) != 1 || head.Magic != CKPT_MAGIC || head.Fs != PT_FS ||
+		head.Seconds != (uint32_t) seconds || head.Snap_Size != snap_size || head.Entry_Size != sizeof(*entry))
+		return (0);
+
+	fseek(fptr_ckpt, 0, SEEK_END);
+	size = ftell(fptr_ckpt);
+	count = (size - (long) sizeof(head)) / (long) (sizeof(*entry) + snap_size);	// A torn last entry is ignored
+
+	while (count-- > 0) {
+		fseek(fptr_ckpt, (long) sizeof(head) + count * (long) (sizeof(*entry) + snap_size), SEEK_SET);
+		if (fread(entry, sizeof(*entry), 1, fptr_ckpt) == 1 && fread(snap, snap_size, 1, fptr_ckpt) == 1 &&
+			PT_Restore(snap) == 0) {
+			fseek(fptr_ckpt, -(long) (sizeof(*entry) + snap_size), SEEK_CUR);	// Rewritten when the run goes on
+			return (1);
+		}
+	}
+	return (0);
+}
+#endif
 
 int main(int argc, char* argv[]) {
 
 	// --------------Input Arguments ------------------ //
-	if (argc == 1 || argc > 3)
+	if (argc == 1 || argc > 6)
 	{
 		printf("\nProvide an input ecg filename!\n");
 		printf("=================================\n");
-		printf("Usage: PanTompkinsCMD FILENAME VERBOSITY\n\n");
+		printf("Usage: PanTompkinsCMD FILENAME VERBOSITY [REPEAT] [CHECKPOINT] [RESUME]\n\n");
 		printf("Example: PanTompkinsCMD ecg.txt 1\n");
 		printf("Reads ecg.txt and prints the results to both console and output file.\n\n");
 		printf("Example: PanTompkinsCMD ecg.txt \n");
-		printf("Reads ecg.txt but does not print to console and only prints to the file.\n");
+		printf("Reads ecg.txt but does not print to console and only prints to the file.\n\n");
+		printf("Example: PanTompkinsCMD ecg.txt 0 100\n");
+		printf("Also runs the detector 100 times over ecg.txt and prints the cost per sample.\n");
+#if (PT_SNAPSHOT == 1)
+		printf("Example: PanTompkinsCMD ecg.txt 0 0 60 1\n");
+		printf("Writes the detector state every 60 seconds of signal to output.ckpt, and resumes\n");
+		printf("from its last checkpoint if the previous run stopped.\n");
+#endif
 		printf("Program prints the results in output.csv\n");
+#if (PT_BEATFILE == 1)
+		printf("and the beats in the binary beat file output.beats\n");
+#endif
+#if (PT_BEATDB == 1)
+		printf("and appends the beats to the beat database output.db (channel 0, msec)\n");
+#endif
 		exit(1);
 	}
 
 
-	int16_t delay, Rcount,s1, s2, s3, s4, s5, ThF1;
-	uint16_t ThI1, SPKI, NPKI;
+	int16_t delay, Rcount;
+	pt_sample_t s1, s2, s3, ThF1;
+	pt_level_t s4, s5, ThI1, SPKI, NPKI;
 	int32_t RLoc, c, SampleCount;
 	SampleCount = 0;
 
 	Rcount = 0;
 	errno_t err, err1;
 
+#if (PT_LOW_LATENCY == 1)
+	// ------- Latency of the provisional and the reported beats in samples ------- //
+	int16_t event;
+	int32_t Pcount = 0, Ccount = 0, Xcount = 0;
+	int32_t lat_prov_sum = 0, lat_beat_sum = 0, lead_sum = 0;
+	int16_t lat_beat_min = INT16_MAX, lat_beat_max = 0;
+#endif
+
+
+	int verbosity = (argc > 2) ? atoi(argv[2]) : 0;
+	int repeat = (argc > 3) ? atoi(argv[3]) : 0;
+
+#if (PT_SNAPSHOT == 1)
+	// ------- Checkpoints every CHECKPOINT seconds of signal, RESUME continues a stopped run ------- //
+	int checkpoint = (argc > 4) ? atoi(argv[4]) : 0;
+	int resume = (argc > 5) ? atoi(argv[5]) : 0;
+	int resumed = 0;
+	int32_t period = (int32_t) checkpoint * PT_FS;
+	FILE *fptr_ckpt = NULL;
+	uint8_t *snap = (uint8_t *) malloc(PT_get_SnapshotSize_output());
+	struct ckpt_entry entry;
+
+	memset(&entry, 0, sizeof(entry));
+	if (snap == NULL)
+	{
+		printf("Not enough memory for the checkpoints\n");
+		exit(1);
+	}
+#endif
+
+	
+	PT_init();															// Always Initialize the Algorithm before use ---> This prepares all filters and parameters
+
+#if (PT_SNAPSHOT == 1)
+	if (checkpoint > 0 && resume && fopen_s(&fptr_ckpt, "output.ckpt", "r+b") == 0)
+	{
+		resumed = CheckpointResume(fptr_ckpt, checkpoint, snap, &entry);
+		if (!resumed)
+			fclose(fptr_ckpt);
+	}
+#endif
+
 
 	// -------------- Reading Input File ------------------ //
 	FILE *fptr, *fptr_out;
 	err  = fopen_s(&fptr, argv[1], "r");
+#if (PT_SNAPSHOT == 1)
+	err1  = resumed ? fopen_s(&fptr_out, "output.csv", "r+") : fopen_s(&fptr_out, "output.csv", "w");
+#else
 	err1  = fopen_s(&fptr_out, "output.csv", "w");
+#endif
 	if( err == 0 || err1 == 0)
 	{
       printf( "The file %s was opened\n", argv[1]);
 
+#if (PT_SNAPSHOT == 1)
+	  if (resumed)
+	  {
+		// ------- Rows after the checkpoint are written again, identical up to where the run stopped ------- //
+		fseek(fptr, (long) entry.In_Pos, SEEK_SET);
+		fseek(fptr_out, (long) entry.Out_Pos, SEEK_SET);
+		SampleCount = entry.SampleCount;
+		Rcount = (int16_t) entry.Rcount;
+		printf("Resumed at sample %d from output.ckpt\n", SampleCount);
+	  }
+	  else
+#endif
 	  // -------header --------//
 	  fprintf_s(fptr_out, "Input,LPFilter,HPFilter,DerivativeF,SQRFilter,MVAFilter,RBeat,RunningThI1,SignalLevel,NoiseLevel,RunningThF\n");
 	}
@@ -82,30 +232,148 @@ int main(int argc, char* argv[]) {
 	  exit(1);
 	}
 
+#if (PT_BEATFILE == 1 || PT_BEATDB == 1)
+	struct PT_beat beat;
+	uint32_t PrevRLoc = 0;
 
+#if (PT_SNAPSHOT == 1)
+	if (resumed)
+		PrevRLoc = entry.PrevRLoc;
+#endif
+#endif
 
-	int verbosity = atoi(argv[2]);
+#if (PT_BEATFILE == 1)
+	// ------- Beats with their flags, a resumed run reopens the file where the checkpoint left it ------- //
+	struct PT_beat_writer beat_writer;
+	int beat_file;
 
-	
-	PT_init();															// Always Initialize the Algorithm before use ---> This prepares all filters and parameters
+#if (PT_SNAPSHOT == 1)
+	if (resumed)
+		beat_file = (PT_BeatWriterReopen(&beat_writer, "output.beats", &entry.Beats) == 0);
+	else
+#endif
+	beat_file = (PT_BeatWriterOpen(&beat_writer, "output.beats", PT_FS) == 0);
+#endif
+
+#if (PT_BEATDB == 1)
+	// ------- A resumed run appends to the same database, the beats it already holds are rejected ------- //
+	struct PT_beat_db beat_db;
+	struct PT_db_beat db_beat;
+	int beat_db_open;
+
+#if (PT_SNAPSHOT == 1)
+	if (resumed)
+		beat_db_open = (PT_DBOpen(&beat_db, "output.db", 1) == 0);
+	else
+#endif
+	beat_db_open = (PT_DBCreate(&beat_db, "output.db", CMD_DB_BLOCKS) == 0);
+#endif
+
+#if (PT_SNAPSHOT == 1)
+	if (checkpoint > 0 && !resumed)
+	{
+		struct ckpt_head head = { CKPT_MAGIC, PT_FS, (uint32_t) checkpoint, PT_get_SnapshotSize_output(), sizeof(entry) };
+
+		if (fopen_s(&fptr_ckpt, "output.ckpt", "wb") != 0)
+		{
+			printf("The file output.ckpt was not opened\n");
+			exit(1);
+		}
+		fwrite(&head, sizeof(head), 1, fptr_ckpt);
+	}
+#endif
 
 	// ------ Pass the signal sample by sample mimicing a real-time scenario ----------- //
-	while (fscanf_s(fptr, "%ld", &c) != EOF) {
+	while (1) {
+#if (PT_SNAPSHOT == 1)
+		if (fptr_ckpt != NULL && SampleCount % period == 0)
+		{
+			entry.SampleCount = SampleCount;
+			entry.Rcount = Rcount;
+#if (PT_BEATFILE == 1 || PT_BEATDB == 1)
+			entry.PrevRLoc = PrevRLoc;
+#endif
+#if (PT_BEATFILE == 1)
+			if (beat_file)
+				PT_BeatWriterMark(&beat_writer, &entry.Beats);
+#endif
+			CheckpointWrite(fptr_ckpt, fptr, fptr_out, snap, &entry);
+		}
+#endif
+		if (fscanf_s(fptr, "%ld", &c) == EOF)
+			break;
 		++SampleCount;
 		
-		delay = PT_StateMachine((int16_t) c);							// This is the main function of the algorithm
+		delay = PT_StateMachine((pt_sample_t) c);							// This is the main function of the algorithm
 
 		// ------- A positive delay to current sample is returned in case of beat detection ----------- //
 		if (delay != 0)
 		{
+#if (PT_R_REFINE == 1)
+			RLoc = SampleCount - ((PT_get_RPeakDelayQ_output() + (1 << (RPK_Q - 1))) >> RPK_Q);	// R apex to the nearest sample
+#else
 			RLoc = SampleCount - (int32_t) delay;
+#endif
 			++Rcount;
+
+#if (PT_BEATFILE == 1 || PT_BEATDB == 1)
+			if (RLoc > 0)
+			{
+				beat.Sample = (uint32_t) RLoc;
+				beat.RR = PrevRLoc ? (int32_t) (beat.Sample - PrevRLoc) : 0;
+				beat.Flags = (delay > PT_get_Delay_output() + PT200MS) ? BF_SEARCHBACK : 0;	// Search-back beats are reported later
+				if (PT_get_HRState_output() == IRREGULAR_HR)
+					beat.Flags |= BF_IRREGULAR;
+#if (PT_LOW_LATENCY == 1)
+				if (PT_get_BeatEvent_output() == BEAT_CONFIRMED)
+					beat.Flags |= BF_PROVISIONAL;
+#endif
+#if (PT_BEATFILE == 1)
+				if (beat_file)
+					PT_BeatWrite(&beat_writer, &beat);
+#endif
+#if (PT_BEATDB == 1)
+				if (beat_db_open)
+				{
+					db_beat.Time = (int64_t) beat.Sample * 1000 / PT_FS;					// msec from the start of the record
+					db_beat.RR = beat.RR * 1000 / PT_FS;
+					db_beat.Flags = beat.Flags;
+					PT_DBAppend(&beat_db, 0, &db_beat);
+				}
+#endif
+				PrevRLoc = beat.Sample;
+			}
+#endif
 		}
 		else
 		{
 			RLoc = 0;
 		}
 
+#if (PT_LOW_LATENCY == 1)
+		// ------- Provisional beats are reported before the blanking time is over ----------- //
+		event = PT_get_BeatEvent_output();
+		if (event == BEAT_PROVISIONAL)
+		{
+			++Pcount;
+			lat_prov_sum += PT_get_ProvisionalDelay_output();
+		}
+		else if (event == BEAT_CONFIRMED)
+		{
+			++Ccount;
+			lead_sum += PT_get_ProvisionalDelay_output() - PT_get_Delay_output();
+		}
+		else if (event == BEAT_RETRACTED)
+			++Xcount;
+
+		if (delay != 0)
+		{
+			lat_beat_sum += delay;
+			if (delay < lat_beat_min) lat_beat_min = delay;
+			if (delay > lat_beat_max) lat_beat_max = delay;
+		}
+#endif
+
 		// -------- Toolbox comes with many helper functions for debugging, see PanTompkins.c for more details ---------- //
 		s1 = PT_get_LPFilter_output();
 		s2 = PT_get_HPFilter_output();
@@ -119,13 +387,74 @@ int main(int argc, char* argv[]) {
 		ThF1 = PT_get_ThF1_output();
 		
 		if (verbosity)
-			printf("%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d\n", c, s1, s2, s3, s4, s5, RLoc, ThI1, SPKI, NPKI, ThF1);
+			printf("%d,%d,%d,%d,%llu,%llu,%d,%llu,%llu,%llu,%d\n", c, s1, s2, s3, (unsigned long long) s4,
+				(unsigned long long) s5, RLoc, (unsigned long long) ThI1, (unsigned long long) SPKI, (unsigned long long) NPKI, ThF1);
 
-		fprintf_s(fptr_out, "%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d\n", c, s1, s2, s3, s4, s5, RLoc, ThI1, SPKI, NPKI, ThF1);
+		fprintf_s(fptr_out, "%d,%d,%d,%d,%llu,%llu,%d,%llu,%llu,%llu,%d\n", c, s1, s2, s3, (unsigned long long) s4,
+			(unsigned long long) s5, RLoc, (unsigned long long) ThI1, (unsigned long long) SPKI, (unsigned long long) NPKI, ThF1);
 		
 	}
 	printf("%d beats detected\n", Rcount);
+#if (PT_LOW_LATENCY == 1)
+	if (Rcount)
+		printf("Beat latency (samples): min %d, mean %d, max %d\n", lat_beat_min, lat_beat_sum / Rcount, lat_beat_max);
+	if (Pcount)
+		printf("Provisional beats: %d (latency %d samples), %d confirmed (%d samples earlier), %d retracted\n",
+			Pcount, lat_prov_sum / Pcount, Ccount, Ccount ? lead_sum / Ccount : 0, Xcount);
+#endif
+
+	// ------ Benchmark: run the detector over the samples held in memory ----------- //
+	if (repeat > 0 && SampleCount > 0)
+	{
+		pt_sample_t *samples = (pt_sample_t *) malloc(SampleCount * sizeof(pt_sample_t));
+		int32_t i, n = 0, beats = 0;
+		long v;
+		int r;
+		clock_t t;
+
+		if (samples == NULL)
+		{
+			printf("Not enough memory for the benchmark\n");
+			exit(1);
+		}
+
+		rewind(fptr);
+		while (n < SampleCount && fscanf_s(fptr, "%ld", &v) == 1)
+			samples[n++] = (pt_sample_t) v;
+
+		t = clock();
+		for (r = 0; r < repeat; ++r)
+		{
+			PT_init();
+			for (i = 0; i < n; ++i)
+				if (PT_StateMachine(samples[i]))
+					++beats;
+		}
+		t = clock() - t;
+
+		printf("Benchmark (%d-bit): %d runs of %d samples (%d beats) in %.3f s, %.1f ns per sample\n", PT_PRECISION, repeat, n,
+			beats / repeat, (double) t / CLOCKS_PER_SEC, 1e9 * (double) t / CLOCKS_PER_SEC / ((double) repeat * n));
+		free(samples);
+	}
+
+#if (PT_SNAPSHOT == 1)
+	if (fptr_ckpt != NULL)
+		fclose(fptr_ckpt);
+	free(snap);
+#endif
+
 	fclose(fptr);
 	fclose(fptr_out);
+
+#if (PT_BEATFILE == 1)
+	if (beat_file)
+		PT_BeatWriterClose(&beat_writer);
+	else if (PT_BeatFileFromCSV("output.csv", "output.beats", PT_FS) >= 0)
+		printf("output.beats converted from output.csv, without beat flags\n");
+#endif
+#if (PT_BEATDB == 1)
+	if (beat_db_open)
+		PT_DBClose(&beat_db);
+#endif
 	return 0;
 }
\ No newline at end of file